@@ -0,0 +1,136 @@
+// Compares the SIMD alpha blending kernels against the scalar reference implementation,
+// both for correctness (bit-exact results) and throughput.
+
+#include <sgfx/blend.hpp>
+#include <sgfx/canvas.hpp>
+#include <sgfx/color.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <vector>
+
+using namespace sgfx;
+using namespace std;
+
+namespace {
+
+char const* name(simd_level level)
+{
+    switch (level)
+    {
+        case simd_level::scalar:
+            return "scalar";
+        case simd_level::sse2:
+            return "sse2";
+        case simd_level::ssse3:
+            return "ssse3";
+        case simd_level::avx2:
+            return "avx2";
+    }
+    return "?";
+}
+
+char const* name(blend_mode mode)
+{
+    switch (mode)
+    {
+        case blend_mode::source_over:
+            return "source-over";
+        case blend_mode::additive:
+            return "additive";
+        case blend_mode::multiply:
+            return "multiply";
+    }
+    return "?";
+}
+
+/// Runs @p f repeatedly for about a quarter of a second and returns the megapixels per second.
+double measure(size_t pixelsPerRun, function<void()> const& f)
+{
+    using clock = chrono::steady_clock;
+
+    auto runs = size_t{0};
+    auto const start = clock::now();
+    auto elapsed = chrono::duration<double>{};
+    do
+    {
+        f();
+        ++runs;
+        elapsed = clock::now() - start;
+    } while (elapsed.count() < 0.25);
+
+    return static_cast<double>(runs * pixelsPerRun) / elapsed.count() / 1e6;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    auto const size = dimension{1024, 768};
+    auto rng = mt19937{42};
+
+    auto background = canvas{size};
+    for (auto& pixel : background.pixels())
+        pixel = color::rgb_color(rng(), rng(), rng());
+
+    auto overlay = rgba_image{size};
+    for (auto& pixel : overlay.pixels())
+        pixel = color::rgba_color(rng(), rng(), rng(), rng());
+
+    // odd offset and width, so that the kernels' scalar tail handling is exercised too
+    auto const fillArea = rectangle{{1, 1}, {size.width - 3, size.height - 1}};
+    auto const fillColor = color::rgba_color{200, 100, 50, 77};
+
+    auto const best = set_blend_simd_level(simd_level::avx2);
+    bool ok = true;
+
+    printf("%-12s %-7s %12s %12s %9s %9s\n", "mode", "simd", "fill Mpx/s", "draw Mpx/s", "fill x", "draw x");
+    for (auto const mode : {blend_mode::source_over, blend_mode::additive, blend_mode::multiply})
+    {
+        set_blend_simd_level(simd_level::scalar);
+        auto referenceFill = background;
+        fill(referenceFill, fillArea, fillColor, mode);
+        auto referenceDraw = background;
+        draw(referenceDraw, overlay, {1, 0}, mode);
+
+        double scalarFill = 0;
+        double scalarDraw = 0;
+
+        for (auto const level : {simd_level::scalar, simd_level::sse2, simd_level::ssse3, simd_level::avx2})
+        {
+            if (level > best)
+                break;
+            set_blend_simd_level(level);
+
+            auto filled = background;
+            fill(filled, fillArea, fillColor, mode);
+            auto drawn = background;
+            draw(drawn, overlay, {1, 0}, mode);
+            if (filled.pixels() != referenceFill.pixels() || drawn.pixels() != referenceDraw.pixels())
+            {
+                fprintf(stderr, "%s/%s: result differs from scalar reference!\n", name(mode), name(level));
+                ok = false;
+            }
+
+            auto target = background;
+            auto const fillRate =
+                measure(size.width * size.height, [&]() { fill(target, {{0, 0}, size}, fillColor, mode); });
+            auto const drawRate =
+                measure(size.width * size.height, [&]() { draw(target, overlay, {0, 0}, mode); });
+
+            if (level == simd_level::scalar)
+            {
+                scalarFill = fillRate;
+                scalarDraw = drawRate;
+            }
+
+            printf("%-12s %-7s %12.1f %12.1f %8.2fx %8.2fx\n", name(mode), name(level), fillRate, drawRate,
+                   fillRate / scalarFill, drawRate / scalarDraw);
+        }
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,372 @@
+// Measures the throughput of the convert pipeline for every pair of file formats populateFilters()
+// supports, on synthetic images of several kinds and sizes.
+//
+// Results are printed as a table and can be written as JSON, including hardware event counts per run where
+// the system allows counting them. Given a JSON file of an earlier run as baseline, every case that got
+// slower by more than a threshold is flagged, and the exit status is nonzero.
+
+#include "flags.hpp"
+#include "pipeline.hpp"
+
+#include <sgfx/canvas.hpp>
+#include <sgfx/color.hpp>
+#include <sgfx/perf_counters.hpp>
+#include <sgfx/primitives.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#    include <x86intrin.h>
+#    define HAVE_RDTSC 1
+#endif
+
+using namespace std;
+using pipeline::Buffer;
+
+namespace {
+
+/// Chunk size the input is converted in, as with convert --block-size.
+size_t chunkSize = pipeline::defaultBlockSize;
+
+/// Formats whose decoding is implemented, i.e. everything but Huffman.
+char const* const inputFormats[] = {"raw", "ppm", "rle", "rle-sprite"};
+char const* const outputFormats[] = {"raw", "ppm", "rle", "rle-sprite", "huffman", "rle+huffman"};
+
+constexpr auto colorkey = sgfx::color::gray;
+
+struct Result {
+    string image;
+    string size;
+    string input;
+    string output;
+    size_t bytes = 0;                // input size
+    double megabytesPerSecond = 0;
+    double cyclesPerByte = -1;       // time stamp counter cycles, if available
+    sgfx::perf_sample counters{};    // hardware events per run, as far as available
+};
+
+string key(Result const& r)
+{
+    return r.image + ' ' + r.size + ' ' + r.input + ' ' + r.output;
+}
+
+/// Renders a synthetic image of the given @p kind.
+sgfx::canvas makeImage(string const& kind, sgfx::dimension size)
+{
+    using namespace sgfx;
+
+    auto image = canvas{size};
+    auto rng = mt19937{42};
+
+    if (kind == "flat")
+        clear(image, color::rgb_color{32, 96, 160});
+    else if (kind == "gradient")
+    {
+        for (int y = 0; y < size.height; ++y)
+            for (int x = 0; x < size.width; ++x)
+                image[{x, y}] = color::rgb_color(static_cast<uint8_t>(255 * x / size.width),
+                                                 static_cast<uint8_t>(255 * y / size.height), 128);
+    }
+    else if (kind == "noise")
+    {
+        for (auto& pixel : image.pixels())
+            pixel = color::rgb_color(rng(), rng(), rng());
+    }
+    else if (kind == "sprite")
+    {
+        // a few flat shapes in a handful of colors on a colorkeyed background
+        clear(image, colorkey);
+        color::rgb_color const palette[] = {color::red, color::yellow, color::black, color::cyan};
+        for (int i = 0; i < 24; ++i)
+        {
+            auto const w = 1 + static_cast<int>(rng() % (size.width / 3 + 1));
+            auto const h = 1 + static_cast<int>(rng() % (size.height / 3 + 1));
+            auto const x = static_cast<int>(rng() % size.width);
+            auto const y = static_cast<int>(rng() % size.height);
+            fill(image, {{x, y}, {w, h}}, palette[i % 4]);
+        }
+    }
+
+    return image;
+}
+
+/// Serializes @p image into convert's raw image format.
+Buffer toRaw(sgfx::canvas const& image)
+{
+    auto raw = Buffer{static_cast<uint8_t>(image.width() & 0xFF), static_cast<uint8_t>(image.width() >> 8),
+                      static_cast<uint8_t>(image.height() & 0xFF), static_cast<uint8_t>(image.height() >> 8)};
+    for (auto const pixel : image.pixels())
+    {
+        raw.push_back(pixel.red());
+        raw.push_back(pixel.green());
+        raw.push_back(pixel.blue());
+    }
+    return raw;
+}
+
+/// Runs @p input through a fresh set of filters, chunk-wise just like convert does.
+Buffer convert(string const& from, string const& to, Buffer const& input)
+{
+    auto const filters = pipeline::populateFilters(from, to, "", colorkey, false);
+    auto result = Buffer{};
+    auto chunk = Buffer{};
+    auto output = Buffer{};
+
+    for (size_t offset = 0; offset < input.size(); offset += chunkSize)
+    {
+        chunk.assign(input.begin() + offset, input.begin() + min(offset + chunkSize, input.size()));
+        auto const& out = pipeline::apply(filters, chunk, output, false);
+        result.insert(result.end(), out.begin(), out.end());
+    }
+
+    auto const& out = pipeline::apply(filters, {}, output, true);
+    result.insert(result.end(), out.begin(), out.end());
+    return result;
+}
+
+uint64_t cycles()
+{
+#if defined(HAVE_RDTSC)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/// Converts @p input repeatedly for at least @p minimumTime seconds.
+Result measure(string const& from, string const& to, Buffer const& input, double minimumTime,
+               sgfx::perf_counters const& counters)
+{
+    using clock = chrono::steady_clock;
+
+    auto runs = size_t{0};
+    auto const startCounters = counters.read();
+    auto const start = clock::now();
+    auto const startCycles = cycles();
+    auto elapsed = chrono::duration<double>{};
+    do
+    {
+        convert(from, to, input);
+        ++runs;
+        elapsed = clock::now() - start;
+    } while (elapsed.count() < minimumTime);
+
+    auto const bytes = static_cast<double>(runs * input.size());
+
+    auto result = Result{};
+    result.input = from;
+    result.output = to;
+    result.bytes = input.size();
+    result.megabytesPerSecond = bytes / elapsed.count() / 1e6;
+#if defined(HAVE_RDTSC)
+    result.cyclesPerByte = static_cast<double>(cycles() - startCycles) / bytes;
+#endif
+    result.counters = counters.read() - startCounters;
+    for (auto& count : result.counters.counts)
+        count /= runs;
+    return result;
+}
+
+/// Formats the instructions per cycle of @p counters, or "-" if they were not counted.
+string instructionsPerCycle(sgfx::perf_sample const& counters)
+{
+    auto const cycles = counters[sgfx::perf_event::cycles];
+    auto const instructions = counters[sgfx::perf_event::instructions];
+    if (!cycles || !counters.has(sgfx::perf_event::instructions))
+        return "-";
+
+    char text[16];
+    snprintf(text, sizeof(text), "%.2f", static_cast<double>(instructions) / cycles);
+    return text;
+}
+
+void writeJson(ostream& os, vector<Result> const& results)
+{
+    os << "{\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        auto const& r = results[i];
+        os << "    {\"image\": \"" << r.image << "\", \"size\": \"" << r.size << "\", \"input\": \""
+           << r.input << "\", \"output\": \"" << r.output << "\", \"bytes\": " << r.bytes
+           << ", \"mb_per_s\": " << r.megabytesPerSecond << ", \"cycles_per_byte\": ";
+        if (r.cyclesPerByte < 0)
+            os << "null";
+        else
+            os << r.cyclesPerByte;
+        for (auto const event : {sgfx::perf_event::cycles, sgfx::perf_event::instructions,
+                                 sgfx::perf_event::branch_misses, sgfx::perf_event::cache_misses})
+        {
+            auto key = string{sgfx::name(event)};
+            replace(key.begin(), key.end(), '-', '_');
+            os << ", \"" << key << "\": ";
+            if (r.counters.has(event))
+                os << r.counters[event];
+            else
+                os << "null";
+        }
+        os << '}' << (i + 1 < results.size() ? "," : "") << '\n';
+    }
+    os << "  ]\n}\n";
+}
+
+/// Extracts the value of @p name from a flat JSON object, without any quotes.
+string field(string const& object, string const& name)
+{
+    auto const label = '"' + name + "\":";
+    auto pos = object.find(label);
+    if (pos == string::npos)
+        return {};
+
+    pos = object.find_first_not_of(" \"", pos + label.size());
+    auto const end = object.find_first_of("\",}", pos);
+    return object.substr(pos, end - pos);
+}
+
+/// Reads the results of a JSON file as written by writeJson().
+map<string, Result> readJson(istream& is)
+{
+    auto const text = string{istreambuf_iterator<char>{is}, istreambuf_iterator<char>{}};
+
+    auto results = map<string, Result>{};
+    for (auto begin = text.find('{', text.find("\"results\"")); begin != string::npos;
+         begin = text.find('{', begin + 1))
+    {
+        auto const object = text.substr(begin, text.find('}', begin) - begin + 1);
+
+        auto r = Result{};
+        r.image = field(object, "image");
+        r.size = field(object, "size");
+        r.input = field(object, "input");
+        r.output = field(object, "output");
+        r.megabytesPerSecond = atof(field(object, "mb_per_s").c_str());
+        results[key(r)] = r;
+    }
+    return results;
+}
+
+}  // namespace
+
+int main(int argc, char const* argv[])
+{
+    flags::Flags cli;
+    cli.defineBool("help", 'h', "Shows this help.");
+    cli.defineString("output", 'o', "PATH", "Writes the results as JSON to this file.", "");
+    cli.defineString("baseline", 'b', "PATH", "Compares the results against a JSON file of an earlier run.",
+                     "");
+    cli.defineFloat("threshold", 't', "PERCENT", "Slowdown against the baseline that counts as regression.",
+                    10.0f);
+    cli.defineFloat("min-time", 0, "SECONDS", "Minimum time to spend measuring each case.", 0.1f);
+    cli.defineNumber("block-size", 0, "BYTES",
+                     "Size of the chunks the input is converted in, as with convert --block-size.",
+                     static_cast<long>(pipeline::defaultBlockSize));
+
+    if (error_code ec = cli.tryParse(argc, argv); ec)
+    {
+        cerr << "Failed to parse command line arguments. " << ec.message() << endl;
+        return EXIT_FAILURE;
+    }
+    if (cli.getBool("help"))
+    {
+        cout << cli.helpText("convert_bench - throughput of the convert pipeline per format pair.\n\n");
+        return EXIT_SUCCESS;
+    }
+
+    auto baseline = map<string, Result>{};
+    if (auto const path = cli.getString("baseline"); !path.empty())
+    {
+        auto is = ifstream{path};
+        if (!is.is_open())
+        {
+            cerr << "Could not open baseline " << path << ".\n";
+            return EXIT_FAILURE;
+        }
+        baseline = readJson(is);
+    }
+
+    if (cli.getNumber("block-size") <= 0)
+    {
+        cerr << "The block size must be positive.\n";
+        return EXIT_FAILURE;
+    }
+    chunkSize = static_cast<size_t>(cli.getNumber("block-size"));
+
+    auto const minimumTime = static_cast<double>(cli.getFloat("min-time"));
+    auto const threshold = static_cast<double>(cli.getFloat("threshold"));
+    auto const sizes = {sgfx::dimension{64, 64}, sgfx::dimension{640, 480}, sgfx::dimension{1920, 1080}};
+
+    auto results = vector<Result>{};
+    auto regressions = 0;
+
+    auto const counters = sgfx::perf_counters{};
+
+    printf("%-9s %-10s %-25s %10s %10s %6s %9s\n", "image", "size", "conversion", "MB/s", "cycles/B", "IPC",
+           "baseline");
+    for (auto const kind : {"flat", "gradient", "noise", "sprite"})
+    {
+        for (auto const size : sizes)
+        {
+            auto const raw = toRaw(makeImage(kind, size));
+            auto const sizeName = to_string(size.width) + 'x' + to_string(size.height);
+
+            for (auto const from : inputFormats)
+            {
+                auto const input = convert("raw", from, raw);
+                for (auto const to : outputFormats)
+                {
+                    // converting to the same format is a pass-through, which is only of interest once
+                    if (string{from} == to && string{from} != "raw")
+                        continue;
+
+                    auto result = measure(from, to, input, minimumTime, counters);
+                    result.image = kind;
+                    result.size = sizeName;
+
+                    auto comparison = string{};
+                    if (auto const i = baseline.find(key(result)); i != baseline.end())
+                    {
+                        auto const previous = i->second.megabytesPerSecond;
+                        auto const change = 100 * (result.megabytesPerSecond / previous - 1);
+                        char text[32];
+                        snprintf(text, sizeof(text), "%+.1f%%%s", change, change < -threshold ? " !" : "");
+                        comparison = text;
+                        regressions += change < -threshold;
+                    }
+
+                    printf("%-9s %-10s %-25s %10.1f %10.2f %6s %9s\n", kind, sizeName.c_str(),
+                           (string{from} + " -> " + to).c_str(), result.megabytesPerSecond,
+                           result.cyclesPerByte, instructionsPerCycle(result.counters).c_str(),
+                           comparison.c_str());
+                    results.emplace_back(move(result));
+                }
+            }
+        }
+    }
+
+    if (auto const path = cli.getString("output"); !path.empty())
+    {
+        auto os = ofstream{path};
+        writeJson(os, results);
+    }
+
+    if (regressions)
+    {
+        fprintf(stderr, "%d case(s) regressed by more than %.1f%% (marked with !).\n", regressions,
+                threshold);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,108 @@
+// Measures the throughput of loading P3 (plain text) PPM images, both on a single thread and using all
+// hardware threads, and of formatting them.
+//
+// Usage: ppm_bench [MIN_MB_PER_S]
+//
+// If a minimum throughput is given, the benchmark fails if parsing is slower than that, which allows
+// holding the parser's performance in automated runs.
+
+#include <sgfx/canvas.hpp>
+#include <sgfx/color.hpp>
+#include <sgfx/image.hpp>
+#include <sgfx/ppm.hpp>
+#include <sgfx/thread_pool.hpp>
+
+#include <experimental/filesystem>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <string>
+
+using namespace sgfx;
+using namespace std;
+
+namespace {
+
+/// Runs @p f repeatedly for about half a second and returns the seconds per run.
+double measure(function<void()> const& f)
+{
+    using clock = chrono::steady_clock;
+
+    auto runs = 0;
+    auto const start = clock::now();
+    auto elapsed = chrono::duration<double>{};
+    do
+    {
+        f();
+        ++runs;
+        elapsed = clock::now() - start;
+    } while (elapsed.count() < 0.5);
+
+    return elapsed.count() / runs;
+}
+
+/// Formats @p image the way common tools write P3 files, with a comment and one channel per line.
+string format_ppm(canvas const& image)
+{
+    auto text = string{"P3\n# synthetic benchmark image\n"};
+    text += to_string(image.width()) + ' ' + to_string(image.height()) + "\n255\n";
+    for (auto const& pixel : image.pixels())
+    {
+        text += to_string(pixel.red()) + '\n';
+        text += to_string(pixel.green()) + '\n';
+        text += to_string(pixel.blue()) + '\n';
+    }
+    return text;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    auto const minimum = argc > 1 ? atof(argv[1]) : 0.0;
+
+    auto rng = mt19937{42};
+    auto image = canvas{{1024, 768}};
+    for (auto& pixel : image.pixels())
+        pixel = color::rgb_color(rng(), rng(), rng());
+
+    auto const text = format_ppm(image);
+    auto const path = (experimental::filesystem::temp_directory_path() / "sgfx_ppm_bench.ppm").string();
+    ofstream{path, ios::binary}.write(text.data(), static_cast<streamsize>(text.size()));
+
+    if (load_ppm(path).pixels() != image.pixels())
+    {
+        fprintf(stderr, "Loaded image differs from the one written.\n");
+        return EXIT_FAILURE;
+    }
+
+    auto const megabytes = static_cast<double>(text.size()) / 1e6;
+    auto const megapixels = static_cast<double>(image.pixels().size()) / 1e6;
+    auto single = thread_pool{1};
+    auto const sequential = measure([&]() { ppm::Parser{}.parseString(text, single); });
+    auto const parse = measure([&]() { ppm::Parser{}.parseString(text); });
+    auto const load = measure([&]() { load_ppm(path); });
+    auto writer = ppm::Writer{};
+    auto const channels = reinterpret_cast<uint8_t const*>(image.pixels().data());
+    auto const format = measure([&]() { writer.write(image.size(), channels, [](char const*, size_t) {}); });
+    experimental::filesystem::remove(path);
+
+    printf("%-10s %10s %10s %10s\n", "", "ms", "MB/s", "Mpx/s");
+    printf("%-10s %10.2f %10.1f %10.1f\n", "sequential", sequential * 1e3, megabytes / sequential,
+           megapixels / sequential);
+    printf("%-10s %10.2f %10.1f %10.1f\n", "parse", parse * 1e3, megabytes / parse, megapixels / parse);
+    printf("%-10s %10.2f %10.1f %10.1f\n", "load_ppm", load * 1e3, megabytes / load, megapixels / load);
+    printf("%-10s %10.2f %10.1f %10.1f\n", "write", format * 1e3, megabytes / format, megapixels / format);
+
+    if (megabytes / parse < minimum)
+    {
+        fprintf(stderr, "Parsing is slower than the required %.1f MB/s.\n", minimum);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,241 @@
+// Measures the throughput of the drawing primitives, blits and image codecs, rendering into an in-memory
+// canvas so that no window is needed.
+//
+// Usage: sgfx_bench [FILTER]
+//
+// Only cases whose name contains FILTER are run, e.g. "draw" or "rle". Every case is measured for several
+// shape sizes, fully inside the target, partially clipped by its edges and entirely outside of it. Rates
+// are given in megapixels of the shape drawn, clipped or not, per second; for shapes outside of the target
+// only the time per call is meaningful. Where the system allows counting hardware events, instructions per
+// cycle and branch and cache misses per call are given as well.
+
+#include <sgfx/canvas.hpp>
+#include <sgfx/color.hpp>
+#include <sgfx/image.hpp>
+#include <sgfx/perf_counters.hpp>
+#include <sgfx/primitives.hpp>
+#include <sgfx/rle_sprite.hpp>
+
+#include <experimental/filesystem>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+
+using namespace sgfx;
+using namespace std;
+
+namespace {
+
+/// Size of the canvas everything is drawn into.
+constexpr auto screenSize = dimension{1024, 768};
+
+/// Background color of the sprite-like test images, which RLE colorkeyed blits skip.
+constexpr auto colorkey = color::gray;
+
+enum class placement { inside, clipped, outside };
+
+char const* name(placement where)
+{
+    switch (where)
+    {
+        case placement::inside:
+            return "inside";
+        case placement::clipped:
+            return "clipped";
+        case placement::outside:
+            return "outside";
+    }
+    return "?";
+}
+
+/// Positions a shape of @p size on the screen such that it is placed @p where.
+point position(dimension size, placement where)
+{
+    switch (where)
+    {
+        case placement::inside:
+            return {(screenSize.width - size.width) / 2, (screenSize.height - size.height) / 2};
+        case placement::clipped:
+            // sticking out of the top left corner by half its size
+            return {-size.width / 2, -size.height / 2};
+        case placement::outside:
+            return {screenSize.width + 1, screenSize.height + 1};
+    }
+    return {0, 0};
+}
+
+struct measurement {
+    double seconds;        // per run
+    perf_sample counters;  // per run
+};
+
+/// Runs @p f repeatedly for about a tenth of a second.
+measurement measure(function<void()> const& f, perf_counters const& counters)
+{
+    using clock = chrono::steady_clock;
+
+    auto runs = 0;
+    auto const startCounters = counters.read();
+    auto const start = clock::now();
+    auto elapsed = chrono::duration<double>{};
+    do
+    {
+        f();
+        ++runs;
+        elapsed = clock::now() - start;
+    } while (elapsed.count() < 0.1);
+
+    auto result = measurement{elapsed.count() / runs, counters.read() - startCounters};
+    for (auto& count : result.counters.counts)
+        count /= runs;
+    return result;
+}
+
+/// Formats @p value with one decimal, or "-" if it is not @p valid.
+string format(bool valid, double value)
+{
+    if (!valid)
+        return "-";
+
+    char text[32];
+    snprintf(text, sizeof(text), "%.1f", value);
+    return text;
+}
+
+/// Renders an image of @p size resembling a sprite: a few flat shapes on a colorkeyed background.
+canvas make_sprite(dimension size)
+{
+    auto image = canvas{size};
+    clear(image, colorkey);
+
+    auto rng = mt19937{42};
+    color::rgb_color const palette[] = {color::red, color::yellow, color::black, color::cyan};
+    for (int i = 0; i < 16; ++i)
+    {
+        auto const w = 1 + static_cast<int>(rng() % (size.width / 2 + 1));
+        auto const h = 1 + static_cast<int>(rng() % (size.height / 2 + 1));
+        auto const x = static_cast<int>(rng() % size.width);
+        auto const y = static_cast<int>(rng() % size.height);
+        fill(image, {{x, y}, {w, h}}, palette[i % 4]);
+    }
+    return image;
+}
+
+class benchmark {
+  public:
+    explicit benchmark(string filter) : filter_{move(filter)}
+    {
+        printf("%-22s %-10s %-8s %12s %12s %6s %10s %10s\n", "case", "size", "where", "Mpx/s", "ns/call",
+               "IPC", "br-miss", "llc-miss");
+    }
+
+    /// Measures @p f drawing @p pixels pixels, if @p name matches the filter.
+    void run(char const* name, dimension size, char const* where, double pixels, function<void()> const& f)
+    {
+        if (string{name}.find(filter_) == string::npos)
+            return;
+
+        auto const [seconds, c] = measure(f, counters_);
+        auto const sizeName = to_string(size.width) + 'x' + to_string(size.height);
+        auto const cycles = c[perf_event::cycles];
+        auto const ipc = format(cycles && c.has(perf_event::instructions),
+                                static_cast<double>(c[perf_event::instructions]) / max(cycles, uint64_t{1}));
+        auto const branchMisses = format(c.has(perf_event::branch_misses), c[perf_event::branch_misses]);
+        auto const cacheMisses = format(c.has(perf_event::cache_misses), c[perf_event::cache_misses]);
+
+        printf("%-22s %-10s %-8s %12s %12.1f %6s %10s %10s\n", name, sizeName.c_str(), where,
+               format(where != string{"outside"}, pixels / seconds / 1e6).c_str(), seconds * 1e9, ipc.c_str(),
+               branchMisses.c_str(), cacheMisses.c_str());
+    }
+
+  private:
+    string filter_;
+    perf_counters counters_;
+};
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    auto bench = benchmark{argc > 1 ? argv[1] : ""};
+    auto screen = canvas{screenSize};
+
+    for (auto const size : {dimension{64, 64}, dimension{640, 480}, dimension{1920, 1080}})
+    {
+        auto target = canvas{size};
+        bench.run("clear", size, "-", size.width * size.height, [&]() { clear(target, color::blue); });
+    }
+
+    auto const shapes = {dimension{16, 16}, dimension{256, 256}, dimension{1024, 768}};
+    auto const placements = {placement::inside, placement::clipped, placement::outside};
+
+    for (auto const size : shapes)
+    {
+        for (auto const where : placements)
+        {
+            auto const p = position(size, where);
+            auto const pixels = static_cast<double>(size.width) * size.height;
+            auto const w = static_cast<uint16_t>(size.width);
+            auto const h = static_cast<uint16_t>(size.height);
+
+            bench.run("fill", size, name(where), pixels, [&]() { fill(screen, {p, size}, color::blue); });
+            bench.run("hline", {size.width, 1}, name(where), w, [&]() { hline(screen, p, w, color::blue); });
+            bench.run("vline", {1, size.height}, name(where), h, [&]() { vline(screen, p, h, color::blue); });
+
+            // a shallow and a steep diagonal across the shape, each plotting as many pixels as its long axis
+            auto const q = point{p.x + size.width - 1, p.y + size.height - 1};
+            auto const r = point{p.x + size.height - 1, p.y + size.width - 1};
+            bench.run("line", size, name(where), max(size.width, size.height) + max(size.width, size.height),
+                      [&]() {
+                          line(screen, p, q, color::blue);
+                          line(screen, p, r, color::blue);
+                      });
+        }
+    }
+
+    for (auto const size : shapes)
+    {
+        auto image = make_sprite(size);
+        auto const encoded = rle_encode(image);
+        auto const sprite = rle_sprite{encoded, colorkey};
+        auto const pixels = static_cast<double>(size.width) * size.height;
+
+        for (auto const where : placements)
+        {
+            auto const p = position(size, where);
+            bench.run("draw(canvas)", size, name(where), pixels, [&]() { draw(screen, image, p); });
+            bench.run("draw(rle_image)", size, name(where), pixels, [&]() { draw(screen, encoded, p); });
+            bench.run("draw(rle_image, key)", size, name(where), pixels,
+                      [&]() { draw(screen, encoded, p, colorkey); });
+            bench.run("draw(rle_sprite)", size, name(where), pixels, [&]() { draw(screen, sprite, p); });
+        }
+
+        bench.run("rle_encode", size, "-", pixels, [&]() { rle_encode(image); });
+    }
+
+    auto const directory = experimental::filesystem::temp_directory_path();
+    auto const ppmPath = (directory / "sgfx_bench.ppm").string();
+    auto const rlePath = (directory / "sgfx_bench.rle").string();
+    for (auto const size : {dimension{64, 64}, dimension{640, 480}, dimension{1920, 1080}})
+    {
+        auto image = make_sprite(size);
+        auto const pixels = static_cast<double>(size.width) * size.height;
+
+        save_ppm(image, ppmPath);
+        bench.run("load_ppm", size, "-", pixels, [&]() { load_ppm(ppmPath); });
+        save_ppm(image, ppmPath, ppm::Format::Binary);
+        bench.run("load_ppm(binary)", size, "-", pixels, [&]() { load_ppm(ppmPath); });
+        save_rle(rle_encode(image), rlePath);
+        bench.run("load_rle", size, "-", pixels, [&]() { load_rle(rlePath); });
+    }
+    experimental::filesystem::remove(ppmPath);
+    experimental::filesystem::remove(rlePath);
+
+    return EXIT_SUCCESS;
+}
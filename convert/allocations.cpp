@@ -0,0 +1,163 @@
+// This file is part of the "convert" project, https://github.com/keithoma>
+//   (c) 2019 Kei Thoma <thomakei@gmail.com>
+//   (c) 2019 Christian Parpart <christian@parpart.family>
+//
+// Licensed under the MIT License (the "License"); you may not use this
+// file except in compliance with the License. You may obtain a copy of
+// the License at: http://opensource.org/licenses/MIT
+
+#include "allocations.hpp"
+
+#include <algorithm>
+#include <list>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+namespace allocations {
+
+namespace {
+
+// Both are constant-initialized, so that allocations during static initialization find them ready.
+atomic<bool> isEnabled{false};
+Counters totalCounters;
+
+thread_local Counters* current = nullptr;
+
+struct Phase {
+    string name;
+    thread::id owner;  // phases are per thread, so that their parent scope does not change under another
+    Counters counters;
+};
+
+struct Registry {
+    mutex lock;
+    list<Phase> phases;  // list, as counters must not move
+    list<Counters> scopes;
+};
+
+Registry& registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+}  // namespace
+
+void enable() noexcept
+{
+    isEnabled = true;
+}
+
+bool enabled() noexcept
+{
+    return isEnabled.load(memory_order_relaxed);
+}
+
+Counters& total() noexcept
+{
+    return totalCounters;
+}
+
+Snapshot snapshot(Counters const& counters) noexcept
+{
+    return Snapshot{counters.count, counters.bytes, counters.peak};
+}
+
+Counters& scope()
+{
+    auto& r = registry();
+    auto const _l = lock_guard<mutex>{r.lock};
+    return r.scopes.emplace_back();
+}
+
+Counters& phase(string const& name)
+{
+    auto& r = registry();
+    auto const _l = lock_guard<mutex>{r.lock};
+    auto const self = this_thread::get_id();
+
+    for (auto& p : r.phases)
+        if (p.name == name && p.owner == self)
+            return p.counters;
+
+    r.phases.emplace_back();
+    r.phases.back().name = name;
+    r.phases.back().owner = self;
+    return r.phases.back().counters;
+}
+
+vector<pair<string, Snapshot>> phases()
+{
+    auto& r = registry();
+    auto const _l = lock_guard<mutex>{r.lock};
+
+    auto result = vector<pair<string, Snapshot>>{};
+    for (auto const& p : r.phases)
+    {
+        auto const matches = [&](auto const& entry) { return entry.first == p.name; };
+        auto i = find_if(result.begin(), result.end(), matches);
+        if (i == result.end())
+            i = result.insert(result.end(), {p.name, Snapshot{}});
+
+        auto const s = snapshot(p.counters);
+        i->second.count += s.count;
+        i->second.bytes += s.bytes;
+        i->second.peak = max(i->second.peak, s.peak);
+    }
+    return result;
+}
+
+Scope::Scope(Counters& counters) noexcept
+{
+    if (enabled())
+        enter(counters);
+}
+
+Scope::Scope(char const* name)
+{
+    if (enabled())
+        enter(phase(name));
+}
+
+void Scope::enter(Counters& counters) noexcept
+{
+    counters_ = &counters;
+    previous_ = current;
+    counters.parent = previous_ ? previous_ : &totalCounters;
+    current = counters_;
+}
+
+Scope::~Scope()
+{
+    if (counters_)
+        current = previous_;
+}
+
+Counters* recordAllocation(size_t size) noexcept
+{
+    if (!enabled())
+        return nullptr;
+
+    auto const owner = current ? current : &totalCounters;
+    for (auto counters = owner; counters; counters = counters->parent.load(memory_order_relaxed))
+    {
+        counters->count.fetch_add(1, memory_order_relaxed);
+        counters->bytes.fetch_add(size, memory_order_relaxed);
+
+        auto const live = counters->live.fetch_add(size, memory_order_relaxed) + size;
+        auto peak = counters->peak.load(memory_order_relaxed);
+        while (live > peak && !counters->peak.compare_exchange_weak(peak, live, memory_order_relaxed))
+            ;
+    }
+    return owner;
+}
+
+void recordDeallocation(Counters* owner, size_t size) noexcept
+{
+    for (auto counters = owner; counters; counters = counters->parent.load(memory_order_relaxed))
+        counters->live.fetch_sub(size, memory_order_relaxed);
+}
+
+}  // namespace allocations
@@ -0,0 +1,108 @@
+// This file is part of the "convert" project, https://github.com/keithoma>
+//   (c) 2019 Kei Thoma <thomakei@gmail.com>
+//   (c) 2019 Christian Parpart <christian@parpart.family>
+//
+// Licensed under the MIT License (the "License"); you may not use this
+// file except in compliance with the License. You may obtain a copy of
+// the License at: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Opt-in heap allocation tracking, attributing allocations to the scopes they happen in.
+ *
+ * Allocations are only seen if the program replaces the global operator new and delete with ones
+ * reporting to recordAllocation() and recordDeallocation(), as convert does in operator_new.cpp.
+ * Otherwise all counters stay zero.
+ */
+namespace allocations {
+
+/**
+ * Allocations made within a scope, including those of its nested scopes.
+ */
+struct Counters {
+    std::atomic<size_t> count{0};
+    std::atomic<size_t> bytes{0};
+    std::atomic<size_t> live{0};  // bytes allocated within the scope and not freed yet
+    std::atomic<size_t> peak{0};  // maximum of live
+    std::atomic<Counters*> parent{nullptr};
+};
+
+/// Values of Counters at one point in time.
+struct Snapshot {
+    size_t count = 0;
+    size_t bytes = 0;
+    size_t peak = 0;
+};
+
+Snapshot snapshot(Counters const& counters) noexcept;
+
+/// Starts tracking allocations made from now on.
+void enable() noexcept;
+
+/// Whether allocations are being tracked.
+bool enabled() noexcept;
+
+/// Counters of all tracked allocations of the process, regardless of scope.
+Counters& total() noexcept;
+
+/**
+ * New counters for a scope of its own, such as a pipeline stage.
+ *
+ * Like those of phases, they are never freed, as blocks allocated within a scope may outlive whatever
+ * owns it and still refer to its counters when freed.
+ */
+Counters& scope();
+
+/// Counters of the calling thread for the phase named @p name, created on first use.
+Counters& phase(std::string const& name);
+
+/**
+ * All phases in order of their first use, summed up over all threads.
+ *
+ * The peak is the highest of any single thread.
+ */
+std::vector<std::pair<std::string, Snapshot>> phases();
+
+/**
+ * Attributes the allocations of the calling thread to the given counters during its lifetime.
+ *
+ * Scopes nest, i.e. allocations count towards all enclosing scopes as well. Does nothing if tracking is
+ * not enabled.
+ */
+class Scope {
+  public:
+    explicit Scope(Counters& counters) noexcept;
+
+    /// Attributes allocations to the phase named @p name, see phase().
+    explicit Scope(char const* name);
+
+    ~Scope();
+
+    Scope(Scope const&) = delete;
+    Scope& operator=(Scope const&) = delete;
+
+  private:
+    void enter(Counters& counters) noexcept;
+
+    Counters* counters_ = nullptr;
+    Counters* previous_ = nullptr;
+};
+
+/**
+ * Records an allocation of @p size bytes on the calling thread.
+ *
+ * @returns the counters to pass to recordDeallocation() when freeing it, or nullptr if not tracked.
+ */
+Counters* recordAllocation(size_t size) noexcept;
+
+/// Records freeing @p size bytes, allocated while @p owner was the innermost scope.
+void recordDeallocation(Counters* owner, size_t size) noexcept;
+
+}  // namespace allocations
@@ -0,0 +1,162 @@
+// This file is part of the "convert" project, https://github.com/keithoma>
+//   (c) 2019 Kei Thoma <thomakei@gmail.com>
+//   (c) 2019 Christian Parpart <christian@parpart.family>
+//
+// Licensed under the MIT License (the "License"); you may not use this
+// file except in compliance with the License. You may obtain a copy of
+// the License at: http://opensource.org/licenses/MIT
+
+#include "async_io.hpp"
+
+#include <sgfx/trace.hpp>
+
+#include <utility>
+
+using namespace std;
+
+namespace async_io {
+
+// -------------------------------------------------------------------------
+// BufferQueue
+
+void BufferQueue::push(pipeline::Buffer buffer)
+{
+    {
+        auto const lock = lock_guard{mutex_};
+        buffers_.emplace_back(move(buffer));
+    }
+    changed_.notify_one();
+}
+
+bool BufferQueue::pop(pipeline::Buffer& buffer)
+{
+    auto lock = unique_lock{mutex_};
+    changed_.wait(lock, [&] { return closed_ || !buffers_.empty(); });
+    if (buffers_.empty())
+        return false;
+
+    buffer = move(buffers_.front());
+    buffers_.pop_front();
+    return true;
+}
+
+void BufferQueue::close()
+{
+    {
+        auto const lock = lock_guard{mutex_};
+        closed_ = true;
+    }
+    changed_.notify_all();
+}
+
+// -------------------------------------------------------------------------
+// Reader
+
+Reader::Reader(istream& source, size_t blockSize, size_t depth) : source_{source}, blockSize_{blockSize}
+{
+    for (size_t i = 0; i < depth; ++i)
+        free_.push(pipeline::Buffer{});
+
+    thread_ = thread{&Reader::run, this};
+}
+
+Reader::~Reader()
+{
+    // in case the caller gave up before the end of the stream
+    stopped_ = true;
+    free_.close();
+    thread_.join();
+}
+
+pipeline::Buffer const& Reader::next()
+{
+    if (holding_)
+        free_.push(move(current_));
+
+    holding_ = filled_.pop(current_);
+    if (!holding_)
+    {
+        if (error_)
+            rethrow_exception(error_);
+        current_.clear();
+    }
+
+    return current_;
+}
+
+void Reader::run()
+{
+    try
+    {
+        for (auto block = pipeline::Buffer{}; !stopped_ && free_.pop(block);)
+        {
+            sgfx::trace_span const span{"read", "io"};
+
+            block.resize(blockSize_);
+            source_.read(reinterpret_cast<char*>(block.data()), blockSize_);
+            block.resize(static_cast<size_t>(source_.gcount()));
+
+            if (block.empty())
+                break;
+
+            filled_.push(move(block));
+        }
+    }
+    catch (...)
+    {
+        error_ = current_exception();  // published to next() by closing filled_
+    }
+
+    filled_.close();
+}
+
+// -------------------------------------------------------------------------
+// Writer
+
+Writer::Writer(ostream& sink, size_t depth) : sink_{sink}
+{
+    // one less, as the caller holds one buffer all the time
+    for (size_t i = 1; i < depth; ++i)
+        free_.push(pipeline::Buffer{});
+
+    thread_ = thread{&Writer::run, this};
+}
+
+Writer::~Writer()
+{
+    if (thread_.joinable())
+    {
+        filled_.close();
+        thread_.join();
+    }
+}
+
+void Writer::write(pipeline::Buffer& data)
+{
+    if (data.empty())
+        return;
+
+    filled_.push(move(data));
+    free_.pop(data);
+    data.clear();
+}
+
+void Writer::finish()
+{
+    filled_.close();
+    thread_.join();
+    sink_.flush();
+}
+
+void Writer::run()
+{
+    for (auto block = pipeline::Buffer{}; filled_.pop(block); free_.push(move(block)))
+    {
+        sgfx::trace_span const span{"write", "io"};
+
+        if (sink_)
+            sink_.write(reinterpret_cast<char const*>(block.data()), static_cast<streamsize>(block.size()));
+    }
+}
+
+}  // namespace async_io
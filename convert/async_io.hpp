@@ -0,0 +1,125 @@
+// This file is part of the "convert" project, https://github.com/keithoma>
+//   (c) 2019 Kei Thoma <thomakei@gmail.com>
+//   (c) 2019 Christian Parpart <christian@parpart.family>
+//
+// Licensed under the MIT License (the "License"); you may not use this
+// file except in compliance with the License. You may obtain a copy of
+// the License at: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include "pipeline.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <istream>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+/**
+ * Reading and writing streams on threads of their own, so that I/O overlaps with running the filters.
+ *
+ * A fixed number of buffers circulates between the I/O thread and the caller, which bounds both the
+ * memory used and how far the I/O thread may run ahead of (or lag behind) the pipeline.
+ */
+namespace async_io {
+
+/**
+ * Buffers handed from one thread to another in FIFO order.
+ */
+class BufferQueue {
+  public:
+    void push(pipeline::Buffer buffer);
+
+    /// Waits for a buffer to take, or returns false if the queue was closed and is empty.
+    bool pop(pipeline::Buffer& buffer);
+
+    /// Wakes up all waiting pop() calls, as no further buffers will be pushed.
+    void close();
+
+  private:
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::deque<pipeline::Buffer> buffers_;
+    bool closed_ = false;
+};
+
+/**
+ * Reads a stream in blocks ahead of their use.
+ */
+class Reader {
+  public:
+    /**
+     * Starts reading @p source on a thread of its own.
+     *
+     * @param source    the stream to read, which must not be used otherwise while this reader exists.
+     * @param blockSize maximum size of each block.
+     * @param depth     number of blocks to read ahead.
+     */
+    Reader(std::istream& source, size_t blockSize, size_t depth);
+    ~Reader();
+
+    Reader(Reader const&) = delete;
+    Reader& operator=(Reader const&) = delete;
+
+    /**
+     * Waits for the next block of the stream.
+     *
+     * @returns the block, valid until the next call, or an empty one at the end of the stream.
+     * @throws whatever reading the stream threw.
+     */
+    pipeline::Buffer const& next();
+
+  private:
+    void run();
+
+    std::istream& source_;
+    size_t const blockSize_;
+    BufferQueue free_;
+    BufferQueue filled_;
+    pipeline::Buffer current_;
+    bool holding_ = false;  // whether current_ came from filled_ and must be recycled
+    std::atomic<bool> stopped_{false};
+    std::exception_ptr error_;
+    std::thread thread_;
+};
+
+/**
+ * Writes blocks to a stream behind their production.
+ *
+ * Once writing fails, the remaining blocks are discarded, leaving the error state in the stream.
+ */
+class Writer {
+  public:
+    /**
+     * Starts writing to @p sink on a thread of its own.
+     *
+     * @param sink  the stream to write to, which must not be used otherwise until finish() returned.
+     * @param depth number of blocks that may be queued before write() waits.
+     */
+    Writer(std::ostream& sink, size_t depth);
+    ~Writer();
+
+    Writer(Writer const&) = delete;
+    Writer& operator=(Writer const&) = delete;
+
+    /// Queues @p data for writing, replacing it with an empty buffer to be reused by the caller.
+    void write(pipeline::Buffer& data);
+
+    /// Waits until all queued blocks are written and the stream is flushed.
+    void finish();
+
+  private:
+    void run();
+
+    std::ostream& sink_;
+    BufferQueue free_;
+    BufferQueue filled_;
+    std::thread thread_;
+};
+
+}  // namespace async_io
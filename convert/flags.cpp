@@ -125,7 +125,7 @@ string Flags::to_s() const
     stringstream sstr;
 
     int i = 0;
-    for (const pair<string, FlagValue>& flag : set_)
+    for (const pair<const string, FlagValue>& flag : set_)
     {
         if (i)
             sstr << ' ';
@@ -7,9 +7,12 @@
 // the License at: http://opensource.org/licenses/MIT
 
 #include "huffman.hpp"
+#include "allocations.hpp"
 #include "bitstream.hpp"
 #include "utils.hpp"
 
+#include <sgfx/trace.hpp>
+
 #include <algorithm>
 #include <map>
 #include <queue>
@@ -190,7 +193,14 @@ Node encode(vector<uint8_t> const& data)
 
     // collect frequencies
     auto freqs = map<uint8_t, unsigned>{};
-    for_each(begin(data), end(data), [&](uint8_t c) { freqs[c]++; });
+    {
+        sgfx::trace_span const span{"histogram", "huffman"};
+        allocations::Scope const scope{"huffman histogram"};
+        for_each(begin(data), end(data), [&](uint8_t c) { freqs[c]++; });
+    }
+
+    sgfx::trace_span const span{"tree", "huffman"};
+    allocations::Scope const scope{"huffman tree"};
 
 	// feed queue
     priority_queue<Node, vector<Node>, NodeGreater> queue;
@@ -6,6 +6,8 @@
 // file except in compliance with the License. You may obtain a copy of
 // the License at: http://opensource.org/licenses/MIT
 
+#include "allocations.hpp"
+#include "async_io.hpp"
 #include "flags.hpp"
 #include "huffman.hpp"
 #include "pipeline.hpp"
@@ -13,14 +15,25 @@
 
 #include "sysconfig.h"
 
+#include <sgfx/color.hpp>
+#include <sgfx/thread_pool.hpp>
+#include <sgfx/trace.hpp>
+
+#include <experimental/filesystem>
+
 #include <algorithm>
+#include <atomic>
 #include <cstdio>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <list>
 #include <memory>
 #include <sstream>
 #include <string>
 #include <system_error>
+#include <thread>
+#include <vector>
 
 #if defined(HAVE_DIRECT_H)
 #    include <direct.h>
@@ -34,6 +47,16 @@
 #    include <unistd.h>
 #endif
 
+#if defined(HAVE_SYS_SENDFILE_H)
+#    include <fcntl.h>
+#    include <sys/sendfile.h>
+#    include <sys/stat.h>
+#endif
+
+#if !defined(STDIN_FILENO)
+#    define STDIN_FILENO (0)
+#endif
+
 #if !defined(STDOUT_FILENO)
 #    define STDOUT_FILENO (1)
 #endif
@@ -56,44 +79,14 @@ static unsigned getTerminalWidth(int terminalFd)
 #endif
 }
 
-static list<pipeline::Filter> populateFilters(string const& input, string const& output,
-                                              string const& huffmanDotOutput, bool debug)
+static sgfx::color::rgb_color parseColor(string const& text)
 {
-    list<pipeline::Filter> filters;
-
-    if (input == "ppm")
-        filters.emplace_back(pipeline::PPMDecoder{});
-    else if (input == "rle")
-        filters.emplace_back(pipeline::RLEDecoder{});
-    else if (input == "huffman")
-        filters.emplace_back(pipeline::HuffmanDecoder{});
-    else if (input == "rle+huffman")
-    {
-        filters.emplace_back(pipeline::HuffmanDecoder{});
-        filters.emplace_back(pipeline::RLEDecoder{});
-    }
-    else if (input != "raw")
-        throw std::runtime_error{"Invalid input format specified: " + input};
-
-    if (output == "ppm")
-        filters.emplace_back(pipeline::PPMEncoder{});
-    else if (output == "rle")
-        filters.emplace_back(pipeline::RLEEncoder{});
-    else if (output == "huffman")
-        filters.emplace_back(pipeline::HuffmanEncoder{huffmanDotOutput, debug});
-    else if (output == "rle+huffman")
-    {
-        filters.emplace_back(pipeline::RLEEncoder{});
-        filters.emplace_back(pipeline::HuffmanEncoder{huffmanDotOutput, debug});
-    }
-    else if (output != "raw")
-        throw std::runtime_error{"Invalid output format specified: " + input};
-
-    if (input == output)
-        // we intentionally populate/destruct so we also have know that file formats were valid.
-        filters.clear();
+    if (text.size() != 6 || text.find_first_not_of("0123456789abcdefABCDEF") != string::npos)
+        throw std::runtime_error{"Invalid color specified (expected RRGGBB): " + text};
 
-    return filters;
+    auto const value = stoul(text, nullptr, 16);
+    return sgfx::color::rgb_color{static_cast<uint8_t>(value >> 16), static_cast<uint8_t>(value >> 8),
+                                  static_cast<uint8_t>(value)};
 }
 
 static void write(ostream& sink, pipeline::Buffer const& source)
@@ -118,20 +111,271 @@ static pipeline::Buffer& read(istream& source, pipeline::Buffer& target)
     return target;
 }
 
+/// How the input is read and the output written.
+struct IOSettings {
+    size_t blockSize;   // size of the chunks read from the input
+    size_t queueDepth;  // number of chunks read ahead and written behind, or 0 for doing either in turn
+};
+
+/// Runs @p source through @p filters into @p sink chunk-wise, reusing the given buffers.
+static void convert(istream& source, ostream& sink, list<pipeline::Filter> const& filters,
+                    IOSettings const& io, pipeline::Buffer& input, pipeline::Buffer& output)
+{
+    if (io.queueDepth)
+    {
+        auto reader = async_io::Reader{source, io.blockSize, io.queueDepth};
+        auto writer = async_io::Writer{sink, io.queueDepth};
+
+        for (auto const* block = &reader.next(); !block->empty(); block = &reader.next())
+            writer.write(pipeline::apply(filters, *block, output, false));
+
+        writer.write(pipeline::apply(filters, {}, output, true));
+        writer.finish();
+        return;
+    }
+
+    input.clear();
+    input.reserve(io.blockSize);
+
+    for (; !read(source, input).empty(); input.clear())
+        write(sink, pipeline::apply(filters, input, output, false));
+
+    // mark end in filter pipeline, in case some filter eventually still has to flush something.
+    write(sink, pipeline::apply(filters, {}, output, true));
+}
+
+/**
+ * Copies the file at @p input to the one at @p output without passing the data through user space, using
+ * splice() if either one is a pipe and sendfile() otherwise, "-" standing for stdin and stdout respectively.
+ *
+ * @returns false, having copied nothing, if the platform or the kind of files do not allow it.
+ */
+static bool copyInKernel(string const& input, string const& output)
+{
+#if defined(HAVE_SYS_SENDFILE_H)
+    auto const isPipe = [](int fd) {
+        struct stat st;
+        return fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+    };
+    auto const closeUnlessStandard = [](int fd) {
+        if (fd > STDERR_FILENO)
+            close(fd);
+    };
+
+    auto const source = input == "-" ? STDIN_FILENO : open(input.c_str(), O_RDONLY | O_CLOEXEC);
+    if (source < 0)
+        throw std::runtime_error{"Could not open file."};
+
+    auto const sink = output == "-" ? STDOUT_FILENO
+                                    : open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (sink < 0)
+    {
+        closeUnlessStandard(source);
+        throw std::runtime_error{"Could not create " + output + "."};
+    }
+
+    auto const usePipe = isPipe(source) || isPipe(sink);
+    auto copied = false;
+    auto n = ssize_t{0};
+    do
+    {
+        n = usePipe ? splice(source, nullptr, sink, nullptr, 1 << 20, SPLICE_F_MOVE | SPLICE_F_MORE)
+                    : sendfile(sink, source, nullptr, 1 << 20);
+        copied = copied || n > 0;
+    } while (n > 0 || (n < 0 && errno == EINTR));
+    auto const error = n < 0 ? errno : 0;
+
+    closeUnlessStandard(source);
+    closeUnlessStandard(sink);
+
+    // e.g. a terminal, or a file opened for appending, which are left to the regular path then
+    if (!copied && (error == EINVAL || error == ENOSYS))
+        return false;
+    if (error)
+        throw std::system_error{error, std::generic_category(), "Could not copy " + input};
+    return true;
+#endif
+    return false;
+}
+
+struct Job {
+    string input;
+    string output;
+};
+
+/// Reads a batch file listing an input and an output path per line, separated by whitespace.
+static vector<Job> readJobs(string const& path)
+{
+    auto in = ifstream{path};
+    if (!in.is_open())
+        throw std::runtime_error{"Could not open batch file: " + path};
+
+    auto jobs = vector<Job>{};
+    auto line = string{};
+    for (unsigned lineNo = 1; getline(in, line); ++lineNo)
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        auto fields = istringstream{line};
+        auto job = Job{};
+        if (!(fields >> job.input >> job.output))
+            throw std::runtime_error{path + ':' + to_string(lineNo)
+                                     + ": Expected an input and an output path."};
+        jobs.emplace_back(move(job));
+    }
+    return jobs;
+}
+
+/// Lists the files in @p directory, each to be written to @p pattern with %s replaced by its name's stem.
+static vector<Job> listJobs(string const& directory, string const& pattern)
+{
+    namespace fs = std::experimental::filesystem;
+
+    auto const placeholder = pattern.find("%s");
+    if (placeholder == string::npos)
+        throw std::runtime_error{"The output pattern must contain %s: " + pattern};
+
+    auto jobs = vector<Job>{};
+    for (auto const& entry : fs::directory_iterator{directory})
+    {
+        if (!fs::is_regular_file(entry.status()))
+            continue;
+
+        auto output = pattern;
+        output.replace(placeholder, 2, entry.path().stem().string());
+        jobs.push_back(Job{entry.path().string(), move(output)});
+    }
+
+    sort(jobs.begin(), jobs.end(), [](Job const& a, Job const& b) { return a.input < b.input; });
+    return jobs;
+}
+
+/**
+ * Converts all @p jobs on @p concurrency threads, each reusing its filters and buffers file after file.
+ *
+ * @param makeFilters constructs the filters, recording their statistics into the given ones, if any.
+ * @param stats       receives the statistics of all threads summed up, if given.
+ *
+ * @returns the number of failed conversions, each of which is reported to stderr.
+ */
+static size_t convertBatch(vector<Job> const& jobs, unsigned concurrency, IOSettings const& io,
+                           function<list<pipeline::Filter>(pipeline::Statistics*)> const& makeFilters,
+                           pipeline::Statistics* stats)
+{
+    // a pool of our own, as filters may use the shared one themselves
+    auto pool = sgfx::thread_pool{concurrency};
+    auto const workers = pool.concurrency();
+
+    auto next = atomic<size_t>{0};
+    auto errors = vector<string>(jobs.size());
+    auto current = vector<pipeline::Statistics>(workers);
+    auto retired = vector<pipeline::Statistics>(workers);  // of filters replaced after an error
+
+    pool.parallel_for(workers, [&](size_t worker) {
+        auto* const workerStats = stats ? &current[worker] : nullptr;
+        auto filters = makeFilters(workerStats);
+        auto input = pipeline::Buffer{};
+        auto output = pipeline::Buffer{};
+
+        for (auto i = next++; i < jobs.size(); i = next++)
+        {
+            sgfx::trace_span const span{"file", "batch"};
+            auto created = false;
+            try
+            {
+                auto source = ifstream{jobs[i].input, ios::binary};
+                if (!source.is_open())
+                    throw std::runtime_error{"Could not open file."};
+
+                auto sink = ofstream{jobs[i].output, ios::binary | ios::trunc};
+                if (!sink.is_open())
+                    throw std::runtime_error{"Could not create " + jobs[i].output + "."};
+                created = true;
+
+                convert(source, sink, filters, io, input, output);
+
+                sink.close();
+                if (!sink)
+                    throw std::runtime_error{"Could not write " + jobs[i].output + "."};
+            }
+            catch (std::exception const& e)
+            {
+                errors[i] = e.what();
+                if (created)
+                    remove(jobs[i].output.c_str());  // rather than leaving a truncated file behind
+
+                // the filters may have been left in the middle of a stream
+                if (workerStats)
+                    pipeline::accumulate(retired[worker], *workerStats);
+                filters = makeFilters(workerStats);
+            }
+        }
+    });
+
+    if (stats)
+    {
+        stats->clear();
+        for (size_t worker = 0; worker < workers; ++worker)
+        {
+            pipeline::accumulate(*stats, retired[worker]);
+            pipeline::accumulate(*stats, current[worker]);
+        }
+    }
+
+    auto failures = size_t{0};
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        if (!errors[i].empty())
+        {
+            cerr << jobs[i].input << ": " << errors[i] << '\n';
+            ++failures;
+        }
+    }
+    if (failures)
+        cerr << failures << " of " << jobs.size() << " conversions failed.\n";
+
+    return failures;
+}
+
 int main(int argc, const char* argv[])
 {
     flags::Flags cli;
     cli.defineBool("help", 'h', "Shows this help.");
     cli.defineBool("debug", 'D', "Enables optional debug printing to stderr.");
     cli.defineString("input-format", 'I', "FORMAT", "Specifies which format the input stream has.", "raw");
-    cli.defineString("input-file", 'i', "PATH", "Specifies the path to the input file to read from.");
+    cli.defineString("input-file", 'i', "PATH",
+                     "Specifies the path to the input file to read from, - for stdin.", "-");
     cli.defineString("output-format", 'O', "FORMAT", "Specifies which format the output stream will be.",
                      "raw");
-    cli.defineString("output-file", 'o', "PATH", "Specifies the path to the output file to write to.");
+    cli.defineString("output-file", 'o', "PATH",
+                     "Specifies the path to the output file to write to, - for stdout.", "-");
+    cli.defineString("batch", 0, "PATH",
+                     "Converts the files listed in this file instead, one input and output path per line.",
+                     "");
+    cli.defineString("input-dir", 0, "PATH",
+                     "Converts all files in this directory instead, see --output-pattern.", "");
+    cli.defineString("output-pattern", 0, "PATTERN",
+                     "Output path for each file of --input-dir, %s standing for its name sans extension.",
+                     "");
+    cli.defineNumber("block-size", 0, "BYTES", "Size of the chunks the input is read and converted in.",
+                     static_cast<long>(pipeline::defaultBlockSize));
+    cli.defineNumber("queue-depth", 0, "COUNT",
+                     "Number of chunks read ahead of and written behind the conversion on two threads of "
+                     "their own, for slow storage or pipes. 0 reads, converts and writes each chunk in turn.",
+                     0);
+    cli.defineNumber("jobs", 'j', "COUNT",
+                     "Number of files converted in parallel in batch mode, by default one per core.", 0);
     cli.defineString(
         "output-dot-huffman", 0, "PATH",
         "When Huffman encoding is chosen, the tree graph in dot file format is stored at this file location.",
         "");
+    cli.defineString("colorkey", 0, "RRGGBB",
+                     "Color of the transparent pixels of RLE sprites, in hexadecimal notation.", "7f7f7f");
+    cli.defineString("trace", 0, "PATH",
+                     "Writes a trace of the pipeline in Chrome trace event format to this file.", "");
+    cli.defineBool("stats", 0,
+                   "Prints statistics of each pipeline stage to stderr at exit. Use --stats=json for JSON.");
 
     if (error_code ec = cli.tryParse(argc, argv); ec)
     {
@@ -150,6 +394,7 @@ int main(int argc, const char* argv[])
             " * raw: no encoding or decoding is happening\n"
             " * ppm: PPM image file\n"
             " * rle: RLE image file\n"
+            " * rle-sprite: RLE sprite file, leaving out the pixels of the colorkey's color\n"
             " * huffman: Huffman (arbitrary file)\n"
             " * rle+huffman: RLE embedded inside Huffman (image file)\n\n";
 
@@ -160,29 +405,80 @@ int main(int argc, const char* argv[])
     {
         try
         {
-            auto const inputFile = cli.getString("input-file");
             auto const inputFormat = cli.getString("input-format");
-            auto const outputFile = cli.getString("output-file");
             auto const outputFormat = cli.getString("output-format");
             auto const huffmanDotOutput = cli.getString("output-dot-huffman");
+            auto const colorkey = parseColor(cli.getString("colorkey"));
             auto const debug = cli.getBool("debug");
+            auto const stats = cli.asString("stats");
+            if (stats != "false" && stats != "true" && stats != "json")
+                throw std::runtime_error{"Invalid statistics format specified: " + stats};
+            if (cli.getNumber("block-size") <= 0 || cli.getNumber("queue-depth") < 0)
+                throw std::runtime_error{"The block size must be positive and the queue depth not negative."};
+            auto const io = IOSettings{static_cast<size_t>(cli.getNumber("block-size")),
+                                       static_cast<size_t>(cli.getNumber("queue-depth"))};
 
-            auto source = ifstream{inputFile, ios::binary};
-            if (!source.is_open())
-                throw std::runtime_error("Could not open file.");
-            auto sink = ofstream{outputFile, ios::binary | ios::trunc};
+            if (auto const trace = cli.getString("trace"); !trace.empty())
+                sgfx::start_tracing(trace);
 
-            auto filters = populateFilters(inputFormat, outputFormat, huffmanDotOutput, debug);
-            auto input = pipeline::Buffer{};
-            auto output = pipeline::Buffer{};
+            if (stats != "false")
+                allocations::enable();
 
-            input.reserve(4096);  // page-size
+            auto const makeFilters = [&](pipeline::Statistics* statistics) {
+                return pipeline::populateFilters(inputFormat, outputFormat, huffmanDotOutput, colorkey, debug,
+                                                 statistics);
+            };
+            auto statistics = pipeline::Statistics{};
+            auto* const statisticsOrNull = stats != "false" ? &statistics : nullptr;
+            auto failures = size_t{0};
 
-            for (; !read(source, input).empty(); input.clear())
-                write(sink, pipeline::apply(filters, input, output, false));
+            if (auto const batch = cli.getString("batch"), inputDir = cli.getString("input-dir");
+                !batch.empty() || !inputDir.empty())
+            {
+                auto const jobs = !batch.empty() ? readJobs(batch)
+                                                 : listJobs(inputDir, cli.getString("output-pattern"));
+                auto const concurrency = static_cast<unsigned>(max(cli.getNumber("jobs"), 0l));
+                failures = convertBatch(jobs, concurrency ? concurrency : thread::hardware_concurrency(), io,
+                                        makeFilters, statisticsOrNull);
+            }
+            else
+            {
+                auto const inputFile = cli.getString("input-file");
+                auto const outputFile = cli.getString("output-file");
+                auto const filters = makeFilters(statisticsOrNull);
 
-            // mark end in filter pipeline, in case some filter eventually still has to flush something.
-            write(sink, pipeline::apply(filters, {}, output, true));
+                // identical formats leave nothing to convert, so the data is copied without looking at it
+                if (!filters.empty() || !copyInKernel(inputFile, outputFile))
+                {
+                    auto file = ifstream{};
+                    if (inputFile != "-" && (file.open(inputFile, ios::binary), !file.is_open()))
+                        throw std::runtime_error{"Could not open " + inputFile + "."};
+
+                    auto outputStream = ofstream{};
+                    if (outputFile != "-"
+                        && (outputStream.open(outputFile, ios::binary | ios::trunc), !outputStream.is_open()))
+                        throw std::runtime_error{"Could not create " + outputFile + "."};
+
+                    istream& source = inputFile != "-" ? file : cin;
+                    ostream& sink = outputFile != "-" ? outputStream : cout;
+
+                    auto input = pipeline::Buffer{};
+                    auto output = pipeline::Buffer{};
+                    convert(source, sink, filters, io, input, output);
+
+                    if (!sink.flush())
+                        throw std::runtime_error{"Could not write "
+                                                 + (outputFile != "-" ? outputFile : string{"stdout"}) + "."};
+                }
+            }
+
+            if (stats != "false")
+                pipeline::printStatistics(cerr, statistics, stats == "json");
+
+            sgfx::stop_tracing();
+
+            if (failures)
+                return EXIT_FAILURE;
         }
         catch (flags::FlagError const& flagError)
         {
@@ -190,6 +486,11 @@ int main(int argc, const char* argv[])
                  << "Try --help instead.\n";
             return EXIT_FAILURE;
         }
+        catch (std::exception const& e)
+        {
+            cerr << e.what() << '\n';
+            return EXIT_FAILURE;
+        }
     }
 
     return EXIT_SUCCESS;
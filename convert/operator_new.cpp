@@ -0,0 +1,100 @@
+// This file is part of the "convert" project, https://github.com/keithoma>
+//   (c) 2019 Kei Thoma <thomakei@gmail.com>
+//   (c) 2019 Christian Parpart <christian@parpart.family>
+//
+// Licensed under the MIT License (the "License"); you may not use this
+// file except in compliance with the License. You may obtain a copy of
+// the License at: http://opensource.org/licenses/MIT
+
+// Replaces the global operator new and delete to report to the allocation tracker, see allocations.hpp.
+//
+// Every block is preceded by a header holding its size and owning scope, so that freeing it is attributed
+// correctly, even if tracking was enabled only after the block was allocated.
+
+#include "allocations.hpp"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+struct alignas(alignof(std::max_align_t)) Header {
+    std::size_t size;
+    allocations::Counters* owner;
+};
+
+void* allocate(std::size_t size) noexcept
+{
+    auto const header = static_cast<Header*>(std::malloc(sizeof(Header) + size));
+    if (!header)
+        return nullptr;
+
+    header->size = size;
+    header->owner = allocations::recordAllocation(size);
+    return header + 1;
+}
+
+void deallocate(void* p) noexcept
+{
+    if (!p)
+        return;
+
+    auto const header = static_cast<Header*>(p) - 1;
+    if (header->owner)
+        allocations::recordDeallocation(header->owner, header->size);
+    std::free(header);
+}
+
+}  // namespace
+
+void* operator new(std::size_t size)
+{
+    if (void* p = allocate(size))
+        return p;
+    throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, std::nothrow_t const&) noexcept
+{
+    return allocate(size);
+}
+
+void* operator new[](std::size_t size, std::nothrow_t const&) noexcept
+{
+    return allocate(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete(void* p, std::nothrow_t const&) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete[](void* p, std::nothrow_t const&) noexcept
+{
+    deallocate(p);
+}
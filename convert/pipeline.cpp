@@ -9,6 +9,7 @@
 // the License at: http://opensource.org/licenses/MIT
 
 #include "pipeline.hpp"
+#include "allocations.hpp"
 #include "bitstream.hpp"
 #include "huffman.hpp"
 #include "utils.hpp"
@@ -16,14 +17,22 @@
 #include <sgfx/color.hpp>
 #include <sgfx/image.hpp>
 #include <sgfx/ppm.hpp>
+#include <sgfx/primitives.hpp>
+#include <sgfx/rle_sprite.hpp>
+#include <sgfx/trace.hpp>
 
+#include <algorithm>
+#include <chrono>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <iterator>
 #include <sstream>
+#include <string_view>
 
 #include <cassert>
 #include <cmath>
+#include <ctime>
 #include <cstdlib>
 
 using namespace std;
@@ -72,6 +81,92 @@ void write(pipeline::Buffer& os, T const& value)
     os.push_back(value & 0xFF);
 }
 
+/**
+ * CPU time consumed by the calling thread so far.
+ *
+ * Unlike clock(), which covers the whole process, this is not inflated by the other threads of a batch.
+ */
+chrono::nanoseconds threadCpuTime() noexcept
+{
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+    auto ts = timespec{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return chrono::seconds{ts.tv_sec} + chrono::nanoseconds{ts.tv_nsec};
+#else
+    return chrono::duration_cast<chrono::nanoseconds>(
+        chrono::duration<double>{static_cast<double>(clock()) / CLOCKS_PER_SEC});
+#endif
+}
+
+/**
+ * Runs a filter, recording its counters into the statistics entry at @p index.
+ */
+class InstrumentedFilter {
+  public:
+    InstrumentedFilter(Filter filter, Statistics& stats, size_t index,
+                       shared_ptr<sgfx::perf_counters const> counters)
+        : filter_{move(filter)},
+          stats_{stats},
+          index_{index},
+          counters_{move(counters)},
+          allocations_{allocations::scope()}
+    {
+    }
+
+    void operator()(Buffer const& input, Buffer& output, bool last)
+    {
+        auto const startCounters = counters_ ? counters_->read() : sgfx::perf_sample{};
+        auto const start = chrono::steady_clock::now();
+        auto const startCpu = threadCpuTime();
+        auto const offset = output.size();
+
+        {
+            allocations::Scope const scope{allocations_};
+            filter_(input, output, last);
+        }
+
+        if (counters_)
+            stats_[index_].counters += counters_->read() - startCounters;
+
+        auto& stage = stats_[index_];
+        stage.calls++;
+        stage.bytesIn += input.size();
+        stage.bytesOut += output.size() - offset;
+        stage.peakBufferSize = max(stage.peakBufferSize, output.size() - offset);
+        stage.wallTime += chrono::steady_clock::now() - start;
+        stage.cpuTime += threadCpuTime() - startCpu;
+        auto const allocated = allocations::snapshot(allocations_);
+        stage.allocations = allocated.count;
+        stage.allocatedBytes = allocated.bytes;
+        stage.peakLiveBytes = allocated.peak;
+    }
+
+  private:
+    Filter filter_;
+    Statistics& stats_;
+    size_t index_;
+    shared_ptr<sgfx::perf_counters const> counters_;  // null if no hardware events can be counted
+    allocations::Counters& allocations_;  // outlives the filter, see allocations::scope()
+};
+
+/**
+ * Runs a filter within a trace span named after it.
+ */
+class TracedFilter {
+  public:
+    TracedFilter(char const* name, Filter filter) : name_{name}, filter_{move(filter)} {}
+
+    void operator()(Buffer const& input, Buffer& output, bool last)
+    {
+        sgfx::trace_span const span{name_, "filter"};
+        filter_(input, output, last);
+    }
+
+  private:
+    char const* name_;
+    Filter filter_;
+};
+
 }  // namespace
 
 // -------------------------------------------------------------------------
@@ -79,6 +174,8 @@ void write(pipeline::Buffer& os, T const& value)
 
 Buffer& apply(list<Filter> const& filters, Buffer const& input, Buffer& output, bool last)
 {
+    sgfx::trace_span const span{"apply", "pipeline"};
+
     auto i = filters.begin();
     auto e = filters.end();
 
@@ -103,6 +200,256 @@ Buffer& apply(list<Filter> const& filters, Buffer const& input, Buffer& output,
     return output;
 }
 
+list<Filter> populateFilters(string const& input, string const& output, string const& huffmanDotOutput,
+                             sgfx::color::rgb_color colorkey, bool debug, Statistics* stats)
+{
+    list<Filter> filters;
+
+    auto counters = shared_ptr<sgfx::perf_counters const>{};
+    if (stats)
+    {
+        stats->clear();
+        if (auto perf = make_shared<sgfx::perf_counters>(); perf->available())
+            counters = move(perf);
+    }
+
+    auto const add = [&](char const* name, Filter filter) {
+        if (stats)
+        {
+            stats->push_back(StageStatistics{name});
+            filter = InstrumentedFilter{move(filter), *stats, stats->size() - 1, counters};
+        }
+        if (sgfx::tracing())
+            filter = TracedFilter{name, move(filter)};
+        filters.emplace_back(move(filter));
+    };
+
+    if (input == "ppm" && (output == "rle" || output == "rle+huffman"))
+    {
+        // there is no need for the raw image in between
+        add("PPMToRLETranscoder", PPMToRLETranscoder{});
+        if (output == "rle+huffman")
+            add("HuffmanEncoder", HuffmanEncoder{huffmanDotOutput, debug});
+        return filters;
+    }
+
+    if (input == "ppm")
+        add("PPMDecoder", PPMDecoder{});
+    else if (input == "rle")
+        add("RLEDecoder", RLEDecoder{});
+    else if (input == "rle-sprite")
+        add("RLESpriteDecoder", RLESpriteDecoder{colorkey});
+    else if (input == "huffman")
+        add("HuffmanDecoder", HuffmanDecoder{});
+    else if (input == "rle+huffman")
+    {
+        add("HuffmanDecoder", HuffmanDecoder{});
+        add("RLEDecoder", RLEDecoder{});
+    }
+    else if (input != "raw")
+        throw std::runtime_error{"Invalid input format specified: " + input};
+
+    if (output == "ppm")
+        add("PPMEncoder", PPMEncoder{});
+    else if (output == "rle")
+        add("RLEEncoder", RLEEncoder{});
+    else if (output == "rle-sprite")
+        add("RLESpriteEncoder", RLESpriteEncoder{colorkey});
+    else if (output == "huffman")
+        add("HuffmanEncoder", HuffmanEncoder{huffmanDotOutput, debug});
+    else if (output == "rle+huffman")
+    {
+        add("RLEEncoder", RLEEncoder{});
+        add("HuffmanEncoder", HuffmanEncoder{huffmanDotOutput, debug});
+    }
+    else if (output != "raw")
+        throw std::runtime_error{"Invalid output format specified: " + output};
+
+    if (input == output)
+    {
+        // we intentionally populate/destruct so we also have know that file formats were valid.
+        filters.clear();
+        if (stats)
+            stats->clear();
+    }
+
+    return filters;
+}
+
+// -------------------------------------------------------------------------
+// Statistics
+
+void accumulate(Statistics& total, Statistics const& stats)
+{
+    if (total.empty())
+        for (auto const& stage : stats)
+            total.push_back(StageStatistics{stage.name});
+
+    for (size_t i = 0; i < min(total.size(), stats.size()); ++i)
+    {
+        auto& sum = total[i];
+        auto const& stage = stats[i];
+        sum.calls += stage.calls;
+        sum.bytesIn += stage.bytesIn;
+        sum.bytesOut += stage.bytesOut;
+        sum.peakBufferSize = max(sum.peakBufferSize, stage.peakBufferSize);
+        sum.wallTime += stage.wallTime;
+        sum.cpuTime += stage.cpuTime;
+        sum.counters += stage.counters;
+        sum.allocations += stage.allocations;
+        sum.allocatedBytes += stage.allocatedBytes;
+        sum.peakLiveBytes = max(sum.peakLiveBytes, stage.peakLiveBytes);
+    }
+}
+
+void printStatistics(ostream& os, Statistics const& stats, bool json)
+{
+    auto const milliseconds = [](chrono::nanoseconds t) {
+        return chrono::duration<double, milli>{t}.count();
+    };
+
+    auto total = StageStatistics{"total"};
+    if (!stats.empty())
+    {
+        total.calls = stats.front().calls;
+        total.bytesIn = stats.front().bytesIn;
+        total.bytesOut = stats.back().bytesOut;
+    }
+    for (auto const& stage : stats)
+    {
+        total.peakBufferSize = max(total.peakBufferSize, stage.peakBufferSize);
+        total.wallTime += stage.wallTime;
+        total.cpuTime += stage.cpuTime;
+        total.counters += stage.counters;
+    }
+
+    // allocations of the whole process rather than the sum of the stages, which is what is worth reducing
+    auto const countersOf = [](string name, allocations::Snapshot const& counters) {
+        auto result = StageStatistics{move(name)};
+        result.allocations = counters.count;
+        result.allocatedBytes = counters.bytes;
+        result.peakLiveBytes = counters.peak;
+        return result;
+    };
+    auto const allocationTotal = countersOf("total", allocations::snapshot(allocations::total()));
+    total.allocations = allocationTotal.allocations;
+    total.allocatedBytes = allocationTotal.allocatedBytes;
+    total.peakLiveBytes = allocationTotal.peakLiveBytes;
+
+    auto phases = vector<StageStatistics>{};
+    for (auto const& [name, counters] : allocations::phases())
+        phases.push_back(countersOf(name, counters));
+
+    sgfx::perf_event const events[] = {sgfx::perf_event::cycles, sgfx::perf_event::instructions,
+                                       sgfx::perf_event::branch_misses, sgfx::perf_event::cache_misses};
+
+    auto const flags = os.flags();
+    os << fixed << setprecision(3);
+
+    if (json)
+    {
+        auto const print = [&](StageStatistics const& stage) {
+            os << "{\"name\": \"" << stage.name << "\", \"calls\": " << stage.calls
+               << ", \"bytes_in\": " << stage.bytesIn << ", \"bytes_out\": " << stage.bytesOut
+               << ", \"peak_buffer_size\": " << stage.peakBufferSize
+               << ", \"wall_ms\": " << milliseconds(stage.wallTime)
+               << ", \"cpu_ms\": " << milliseconds(stage.cpuTime) << ", \"ratio\": " << stage.ratio();
+            for (auto const event : events)
+            {
+                auto key = string{sgfx::name(event)};
+                replace(key.begin(), key.end(), '-', '_');
+                os << ", \"" << key << "\": ";
+                if (stage.counters.has(event))
+                    os << stage.counters[event];
+                else
+                    os << "null";
+            }
+            os << ", \"allocations\": " << stage.allocations
+               << ", \"allocated_bytes\": " << stage.allocatedBytes
+               << ", \"peak_live_bytes\": " << stage.peakLiveBytes << '}';
+        };
+
+        os << "{\"stages\": [";
+        for (size_t i = 0; i < stats.size(); ++i)
+        {
+            os << (i ? ",\n  " : "\n  ");
+            print(stats[i]);
+        }
+        os << "],\n \"phases\": [";
+        for (size_t i = 0; i < phases.size(); ++i)
+        {
+            auto const& phase = phases[i];
+            os << (i ? ",\n  " : "\n  ") << "{\"name\": \"" << phase.name << "\", \"allocations\": "
+               << phase.allocations << ", \"allocated_bytes\": " << phase.allocatedBytes
+               << ", \"peak_live_bytes\": " << phase.peakLiveBytes << '}';
+        }
+        os << "],\n \"total\": ";
+        print(total);
+        os << "}\n";
+    }
+    else
+    {
+        auto const print = [&](StageStatistics const& stage) {
+            os << left << setw(18) << stage.name << right << setw(8) << stage.calls << setw(12)
+               << stage.bytesIn << setw(12) << stage.bytesOut << setw(12) << stage.peakBufferSize << setw(11)
+               << milliseconds(stage.wallTime) << setw(11) << milliseconds(stage.cpuTime) << setw(8)
+               << stage.ratio() << '\n';
+        };
+
+        os << left << setw(18) << "stage" << right << setw(8) << "calls" << setw(12) << "bytes in"
+           << setw(12) << "bytes out" << setw(12) << "peak out" << setw(11) << "wall ms" << setw(11)
+           << "cpu ms" << setw(8) << "ratio" << '\n';
+        for (auto const& stage : stats)
+            print(stage);
+        print(total);
+
+        if (total.counters.counted)
+        {
+            auto const printCounters = [&](StageStatistics const& stage) {
+                os << left << setw(18) << stage.name << right;
+                for (auto const event : events)
+                {
+                    if (stage.counters.has(event))
+                        os << setw(15) << stage.counters[event];
+                    else
+                        os << setw(15) << '-';
+                }
+                auto const cycles = stage.counters[sgfx::perf_event::cycles];
+                auto const instructions = stage.counters[sgfx::perf_event::instructions];
+                if (cycles && stage.counters.has(sgfx::perf_event::instructions))
+                    os << setw(8) << static_cast<double>(instructions) / cycles;
+                os << '\n';
+            };
+
+            os << '\n' << left << setw(18) << "stage" << right;
+            for (auto const event : events)
+                os << setw(15) << sgfx::name(event);
+            os << setw(8) << "IPC" << '\n';
+            for (auto const& stage : stats)
+                printCounters(stage);
+            printCounters(total);
+        }
+
+        if (allocations::enabled())
+        {
+            auto const printAllocations = [&](StageStatistics const& stage) {
+                os << left << setw(18) << stage.name << right << setw(13) << stage.allocations << setw(15)
+                   << stage.allocatedBytes << setw(15) << stage.peakLiveBytes << '\n';
+            };
+
+            os << '\n' << left << setw(18) << "stage/phase" << right << setw(13) << "allocations" << setw(15)
+               << "bytes" << setw(15) << "peak live" << '\n';
+            for (auto const& stage : stats)
+                printAllocations(stage);
+            for (auto const& phase : phases)
+                printAllocations(phase);
+            printAllocations(total);
+        }
+    }
+
+    os.flags(flags);
+}
+
 // -------------------------------------------------------------------------
 // PPM Encoder & Decoder
 
@@ -112,7 +459,6 @@ void PPMDecoder::operator()(Buffer const& input, Buffer& output, bool last)
 
     if (last)
     {
-        ranges::copy(input, back_inserter(cache_));
         sgfx::canvas const canvas = sgfx::ppm::Parser{}.parseString(cache_);
 
         auto out = back_inserter(output);
@@ -131,27 +477,10 @@ void PPMDecoder::operator()(Buffer const& input, Buffer& output, bool last)
             *out++ = color.green();
             *out++ = color.blue();
         }
+        cache_.clear();
     }
 }
 
-void PPMEncoder::write(Buffer& output, char const* text)
-{
-    while (*text)
-        output.push_back(*text++);
-}
-
-void PPMEncoder::write(Buffer& output, unsigned value)
-{
-    char buf[32];
-    snprintf(buf, sizeof(buf), "%u", value);
-    write(output, buf);
-}
-
-void PPMEncoder::write(Buffer& output, char ch)
-{
-    output.push_back(ch);
-}
-
 void PPMEncoder::operator()(Buffer const& input, Buffer& output, bool last)
 {
     ranges::copy(input, back_inserter(cache_));
@@ -159,23 +488,19 @@ void PPMEncoder::operator()(Buffer const& input, Buffer& output, bool last)
     if (last)
     {
         auto const& input = cache_;
+        if (input.size() < 4)
+            throw std::runtime_error{"Unexpected end of image header."};
 
         unsigned const width = input[0] | (input[1] << 8);
         unsigned const height = input[2] | (input[3] << 8);
-
-        write(output, "P3\n");
-        write(output, width);
-        write(output, ' ');
-        write(output, height);
-        write(output, '\n');
-        write(output, "255\n");  // largest value
-
-        for (size_t i = 4; i + 2 < input.size(); i += 3)
-        {
-            char buf[128];
-            snprintf(buf, sizeof(buf), "%u %u %u\n", input[i + 0], input[i + 1], input[i + 2]);
-            write(output, buf);
-        }
+        if (input.size() < 4 + 3 * size_t{width} * height)
+            throw std::runtime_error{"Unexpected end of pixel data."};
+
+        auto const dim = sgfx::dimension{static_cast<int>(width), static_cast<int>(height)};
+        writer_.write(dim, input.data() + 4, [&](char const* data, size_t size) {
+            output.insert(output.end(), data, data + size);
+        });
+        cache_.clear();
     }
 }
 
@@ -218,6 +543,7 @@ void RLEDecoder::operator()(Buffer const& input, Buffer& output, bool last)
                 }
             }
         }
+        cache_.clear();
     }
 }
 
@@ -272,11 +598,165 @@ void RLEEncoder::operator()(Buffer const& input, Buffer& output, bool last)
                 abort();
         }
     }
+
+    if (last)
+    {
+        // ready for the next image
+        cache_.clear();
+        state_ = RLEState::Width1;
+        width_ = height_ = currentLine_ = currentColumn_ = 0;
+    }
+}
+
+// -------------------------------------------------------------------------
+// PPM to RLE Transcoder
+
+void PPMToRLETranscoder::operator()(Buffer const& input, Buffer& output, bool last)
+{
+    static_assert(sizeof(sgfx::color::rgb_color) == 3, "rgb_color must be tightly packed.");
+
+    auto data = string_view{reinterpret_cast<char const*>(input.data()), input.size()};
+    auto pixelData = string{};
+
+    if (!header_ || header_->format == sgfx::ppm::Format::Plain)
+    {
+        cache_.append(data);
+        data = {};
+    }
+
+    if (!header_)
+    {
+        header_ = sgfx::ppm::Parser{}.parseHeader(cache_);
+        if (!header_)
+        {
+            if (last)
+                sgfx::ppm::Parser{}.parseString(cache_);  // reports what is wrong with the header
+            return;
+        }
+
+        auto const width = static_cast<unsigned>(header_->size.width);
+        auto const height = static_cast<unsigned>(header_->size.height);
+        output.insert(output.end(), {static_cast<uint8_t>(width & 0xFF), static_cast<uint8_t>(width >> 8),
+                                     static_cast<uint8_t>(height & 0xFF), static_cast<uint8_t>(height >> 8)});
+        rowsLeft_ = height;
+
+        // binary pixel data is taken from the input in place from now on
+        if (header_->format == sgfx::ppm::Format::Binary)
+        {
+            pixelData = cache_.substr(header_->length);
+            cache_.clear();
+            data = pixelData;
+        }
+    }
+
+    auto const width = static_cast<size_t>(header_->size.width);
+    if (header_->format == sgfx::ppm::Format::Binary)
+    {
+        auto const rowSize = 3 * width;
+        auto const encodeRow = [&](char const* row) {
+            sgfx::rle_image::encodeLine(reinterpret_cast<uint8_t const*>(row), width, output);
+            --rowsLeft_;
+        };
+
+        // complete the row the previous chunk ended in
+        if (!cache_.empty())
+        {
+            auto const missing = min(rowSize - cache_.size(), data.size());
+            cache_.append(data.substr(0, missing));
+            data.remove_prefix(missing);
+            if (cache_.size() == rowSize)
+            {
+                encodeRow(cache_.data());
+                cache_.clear();
+            }
+        }
+
+        for (; rowsLeft_ && data.size() >= rowSize; data.remove_prefix(rowSize))
+            encodeRow(data.data());
+
+        if (!rowsLeft_ && !data.empty())
+            throw std::runtime_error{"Unexpected data after the last pixel."};
+
+        cache_.append(data);
+    }
+    else if (last)
+    {
+        // plain text rows vary in length, so the pixel data is parsed at once
+        auto const canvas = sgfx::ppm::Parser{}.parseString(cache_);
+        auto const pixels = reinterpret_cast<uint8_t const*>(canvas.pixels().data());
+        for (size_t y = 0; y < rowsLeft_; ++y)
+            sgfx::rle_image::encodeLine(pixels + 3 * width * y, width, output);
+        rowsLeft_ = 0;
+    }
+
+    if (last)
+    {
+        if (rowsLeft_)
+            throw std::runtime_error{"Unexpected end of pixel data."};
+
+        // ready for the next image
+        cache_.clear();
+        header_.reset();
+    }
+}
+
+// -------------------------------------------------------------------------
+// RLE Sprite Encoder & Decoder
+
+void RLESpriteDecoder::operator()(Buffer const& input, Buffer& output, bool last)
+{
+    ranges::copy(input, back_inserter(cache_));
+
+    if (last)
+    {
+        auto const sprite = sgfx::rle_sprite::load(cache_);
+        auto canvas = sgfx::canvas{sprite.size()};
+        sgfx::clear(canvas, colorkey_);
+        sgfx::draw(canvas, sprite, {0, 0});
+
+        auto out = back_inserter(output);
+
+        // encode 16-bit width and height
+        *out++ = canvas.width() & 0xFF;
+        *out++ = (canvas.width() >> 8) & 0xFF;
+        *out++ = canvas.height() & 0xFF;
+        *out++ = (canvas.height() >> 8) & 0xFF;
+
+        for (sgfx::color::rgb_color color : canvas.pixels())
+        {
+            *out++ = color.red();
+            *out++ = color.green();
+            *out++ = color.blue();
+        }
+        cache_.clear();
+    }
+}
+
+void RLESpriteEncoder::operator()(Buffer const& input, Buffer& output, bool last)
+{
+    ranges::copy(input, back_inserter(cache_));
+
+    if (last)
+    {
+        if (cache_.size() < 4)
+            throw std::runtime_error{"Unexpected end of image header."};
+
+        unsigned const width = cache_[0] | (cache_[1] << 8);
+        unsigned const height = cache_[2] | (cache_[3] << 8);
+        if (cache_.size() < 4 + 3 * size_t{width} * height)
+            throw std::runtime_error{"Unexpected end of pixel data."};
+
+        // the header of raw images and RLE sprites is the same
+        output.insert(output.end(), cache_.begin(), cache_.begin() + 4);
+        for (unsigned y = 0; y < height; ++y)
+            sgfx::rle_sprite::encode_row(cache_.data() + 4 + 3 * size_t{width} * y, width, colorkey_, output);
+        cache_.clear();
+    }
 }
 
 void HuffmanDecoder::operator()(Buffer const& input, Buffer& output, bool last)
 {
-    uint64_t const originalSize =
+    [[maybe_unused]] uint64_t const originalSize =
         static_cast<uint64_t>(input[0]) << 56 | static_cast<uint64_t>(input[1]) << 48
         | static_cast<uint64_t>(input[2]) << 40 | static_cast<uint64_t>(input[3]) << 32
         | static_cast<uint64_t>(input[4]) << 24 | static_cast<uint64_t>(input[5]) << 16
@@ -288,7 +768,7 @@ void HuffmanDecoder::operator()(Buffer const& input, Buffer& output, bool last)
     // TODO: read code table
 
     // TODO: read data payload
-    size_t decodedByteCount = 0;
+    [[maybe_unused]] size_t decodedByteCount = 0;
 
     assert(decodedByteCount == originalSize);
 }
@@ -298,7 +778,10 @@ void HuffmanEncoder::operator()(Buffer const& input, Buffer& output, bool last)
     ranges::copy(input, back_inserter(cache_));
 
     if (last)
+    {
         encode(cache_, output, dotfile_, debug_);
+        cache_.clear();
+    }
 }
 
 void HuffmanEncoder::encode(Buffer const& input, Buffer& output, string const& dotfileName, bool debug)
@@ -358,6 +841,8 @@ void HuffmanEncoder::encode(Buffer const& input, Buffer& output, string const& d
     };
 
     auto const root = huffman::encode(input);
+    auto tableSpan = optional<sgfx::trace_span>{in_place, "table", "huffman"};
+    auto tableScope = optional<allocations::Scope>{in_place, "huffman table"};
     auto const codeTable = huffman::CodeTable{huffman::encode(root)};
     auto writer = bitstream::BitStreamWriter{flusher(output, debug)};
 
@@ -382,7 +867,12 @@ void HuffmanEncoder::encode(Buffer const& input, Buffer& output, string const& d
             writer.writeAligned<uint8_t>(b);
     }
 
+    tableScope.reset();
+    tableSpan.reset();
+
     // payload
+    sgfx::trace_span const payloadSpan{"payload", "huffman"};
+    allocations::Scope const payloadScope{"huffman payload"};
     if (debug)
         printf("Data:\n");
     for (auto const sym : input)
@@ -10,6 +10,11 @@
 
 #pragma once
 
+#include <sgfx/color.hpp>
+#include <sgfx/perf_counters.hpp>
+#include <sgfx/ppm.hpp>
+
+#include <chrono>
 #include <functional>
 #include <iosfwd>
 #include <list>
@@ -26,6 +31,9 @@ namespace pipeline {
 
 using Buffer = std::vector<uint8_t>;
 
+/// Size of the chunks convert reads its input in, unless set by --block-size.
+constexpr std::size_t defaultBlockSize = 64 * 1024;
+
 // -----------------------------------------------------------------------------
 // Filter API
 
@@ -52,6 +60,65 @@ using Filter = std::function<void(Buffer const& /*input*/, Buffer& /*output*/, b
  */
 Buffer& apply(const std::list<Filter>& filters, const Buffer& input, Buffer& output, bool last);
 
+// -----------------------------------------------------------------------------
+// Statistics
+
+/**
+ * Counters of a single filter, accumulated over all chunks passed through it.
+ */
+struct StageStatistics {
+    std::string name;
+    size_t calls = 0;
+    size_t bytesIn = 0;
+    size_t bytesOut = 0;
+    size_t peakBufferSize = 0;  // largest output of a single call
+    std::chrono::nanoseconds wallTime{};
+    std::chrono::nanoseconds cpuTime{};  // of the thread running the stage, without work handed to a pool
+    sgfx::perf_sample counters{};        // hardware events, as far as available
+    size_t allocations = 0;              // heap allocations, if tracked (see allocations.hpp)
+    size_t allocatedBytes = 0;
+    size_t peakLiveBytes = 0;            // most bytes allocated within this stage and not freed at once
+
+    /// Output bytes per input byte, i.e. below 1 if this stage compresses.
+    double ratio() const noexcept { return bytesIn ? static_cast<double>(bytesOut) / bytesIn : 0.0; }
+};
+
+using Statistics = std::vector<StageStatistics>;
+
+/**
+ * Adds the counters of @p stats to those of the same stages in @p total, e.g. to sum up the statistics of
+ * several pipelines of the same filters. Peaks are combined by their maximum.
+ *
+ * @p total is resized to the number of stages of @p stats if it is empty.
+ */
+void accumulate(Statistics& total, Statistics const& stats);
+
+/**
+ * Prints a table of @p stats, one row per stage, followed by the totals of the whole pipeline.
+ * Hardware event counts follow in a second table if they were available, and heap allocations per stage
+ * and phase in a third one if allocations were tracked.
+ *
+ * @param json prints a JSON object instead of a table.
+ */
+void printStatistics(std::ostream& os, Statistics const& stats, bool json);
+
+/**
+ * Constructs the filters converting from the @p input to the @p output file format.
+ *
+ * @param huffmanDotOutput optional file to store the Huffman tree graph to, in dot file format.
+ * @param colorkey         color of the transparent pixels of RLE sprites.
+ * @param debug            enables optional debug printing to stderr.
+ * @param stats            if given, each filter is instrumented to record its counters here, in order.
+ *                         Otherwise the filters run without any overhead.
+ *
+ * If sgfx::tracing() is enabled already, each filter call is recorded as trace span, named after the filter.
+ *
+ * @throws std::runtime_error if either format is not supported.
+ */
+std::list<Filter> populateFilters(std::string const& input, std::string const& output,
+                                  std::string const& huffmanDotOutput, sgfx::color::rgb_color colorkey,
+                                  bool debug, Statistics* stats = nullptr);
+
 /**
  * Decodes a single PPM image file stream chunk-wise.
  */
@@ -63,17 +130,18 @@ class PPMDecoder {
     std::string cache_;
 };
 
+/**
+ * Encodes a raw image stream into a single PPM image file.
+ */
 class PPMEncoder {
   public:
-    void operator()(Buffer const& input, Buffer& output, bool last);
+    explicit PPMEncoder(sgfx::ppm::Format format = sgfx::ppm::Format::Plain) : writer_{format} {}
 
-  private:
-    void write(Buffer& output, char const* text);
-    void write(Buffer& output, unsigned value);
-    void write(Buffer& output, char ch);
+    void operator()(Buffer const& input, Buffer& output, bool last);
 
   private:
     Buffer cache_;
+    sgfx::ppm::Writer writer_;
 };
 
 class RLEDecoder {
@@ -107,6 +175,50 @@ class RLEEncoder {
     unsigned currentColumn_ = 0;
 };
 
+/**
+ * Encodes a PPM image file into an RLE image file directly, without the raw image in between.
+ *
+ * Binary (P6) pixel data is encoded row by row as it arrives. Plain text (P3) pixel data is parsed at once
+ * and encoded straight from the parsed image.
+ */
+class PPMToRLETranscoder {
+  public:
+    void operator()(Buffer const& input, Buffer& output, bool last);
+
+  private:
+    std::string cache_;  // input not consumed yet, e.g. an incomplete header or row
+    std::optional<sgfx::ppm::Header> header_;
+    unsigned rowsLeft_ = 0;
+};
+
+/**
+ * Decodes an RLE sprite file, filling its transparent parts with a colorkey.
+ */
+class RLESpriteDecoder {
+  public:
+    explicit RLESpriteDecoder(sgfx::color::rgb_color colorkey) : colorkey_{colorkey} {}
+
+    void operator()(const Buffer& input, Buffer& output, bool last);
+
+  private:
+    sgfx::color::rgb_color colorkey_;
+    std::string cache_;
+};
+
+/**
+ * Encodes a raw image stream into an RLE sprite file, leaving out all pixels of the colorkey's color.
+ */
+class RLESpriteEncoder {
+  public:
+    explicit RLESpriteEncoder(sgfx::color::rgb_color colorkey) : colorkey_{colorkey} {}
+
+    void operator()(const Buffer& input, Buffer& output, bool last);
+
+  private:
+    sgfx::color::rgb_color colorkey_;
+    Buffer cache_;
+};
+
 class HuffmanEncoder {
   public:
     HuffmanEncoder(std::string dotfile, bool debug) : dotfile_{move(dotfile)}, debug_{debug} {}
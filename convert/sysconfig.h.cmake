@@ -3,3 +3,4 @@
 #cmakedefine HAVE_DIRECT_H
 #cmakedefine HAVE_UNISTD_H
 #cmakedefine HAVE_IOCTL_H
+#cmakedefine HAVE_SYS_SENDFILE_H
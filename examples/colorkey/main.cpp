@@ -3,7 +3,7 @@
 #include <sgfx/image.hpp>
 #include <sgfx/key.hpp>
 #include <sgfx/primitives.hpp>
-#include <sgfx/window.hpp>
+#include <sgfx/screen.hpp>
 
 #include <algorithm>
 
@@ -11,7 +11,8 @@ int main(int argc, char* argv[])
 {
 	using namespace sgfx;
 	
-	window main_window{1024,768};
+	auto screen = make_screen(1024,768);
+	auto& main_window = *screen;
 	
 	canvas img{{64,64}};
 	clear(img,color::green);
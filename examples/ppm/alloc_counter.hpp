@@ -0,0 +1,6 @@
+#pragma once
+
+#include <cstddef>
+
+/// Number of heap allocations made through the global operator new so far.
+std::size_t allocation_count() noexcept;
@@ -1,16 +1,21 @@
+#include "alloc_counter.hpp"
+
 #include <cstdlib>
+#include <iostream>
 #include <sgfx/canvas.hpp>
+#include <sgfx/canvas_pool.hpp>
 #include <sgfx/color.hpp>
 #include <sgfx/image.hpp>
 #include <sgfx/key.hpp>
 #include <sgfx/primitives.hpp>
-#include <sgfx/window.hpp>
+#include <sgfx/screen.hpp>
 
 int main(int argc, char* argv[])
 {
     using namespace sgfx;
 
-    window main_window{640, 480};
+    auto screen = make_screen(640, 480);
+    auto& main_window = *screen;
 
     auto bg_img = load_ppm("sample_bg.ppm");
     point bg_pos{0, 0};
@@ -20,9 +25,15 @@ int main(int argc, char* argv[])
     point fg_pos{main_window.width() / 2 - fg_img.width() / 2,
                  main_window.height() / 2 - fg_img.height() / 2};
 
+    canvas_pool scratch;
+    std::size_t frames = 0;
+    std::size_t steady_allocations = 0;
+
     bool plus_released = true;
     while (main_window.handle_events() && !main_window.should_close())
     {
+        auto const allocations_before = allocation_count();
+
         constexpr int spd = 3;
         if (main_window.is_pressed(key_id{'w'}))
             fg_pos.y -= spd;
@@ -53,10 +64,18 @@ int main(int argc, char* argv[])
         draw(main_window, bg_img, bg_pos);
         draw(main_window, bg_img, bg_pos - point{0, bg_img.height()});
 
-        draw(main_window, canvas::colored(fg_img.size(), color::cyan), fg_pos);
+        draw(main_window, scratch.acquire(fg_img.size(), color::cyan), fg_pos);
 
         main_window.show();
+        scratch.reset();
+
+        // the first frame warms up the canvas pool, every further one should not allocate at all
+        if (frames++ != 0)
+            steady_allocations += allocation_count() - allocations_before;
     };
 
+    std::cerr << "Heap allocations after the first of " << frames << " frames: " << steady_allocations
+              << '\n';
+
     return 0;
 }
@@ -1,6 +1,7 @@
 #include <sgfx/color.hpp>
 #include <sgfx/image.hpp>
-#include <sgfx/window.hpp>
+#include <sgfx/rle_sprite.hpp>
+#include <sgfx/screen.hpp>
 
 #include <chrono>
 #include <thread>
@@ -10,13 +11,14 @@ int main(int argc, char* argv[])
     using namespace sgfx;
     using namespace std::chrono_literals;
 
-    window main_window{1024, 768};
+    auto screen = make_screen(1024, 768);
+    auto& main_window = *screen;
 
     auto bg = load_rle("sample_bg.ppm.rle");
-    auto fg = load_rle("sample_fg.ppm.rle");
+    auto fg = rle_sprite{load_rle("sample_fg.ppm.rle"), color::gray};
 
     draw(main_window, bg, {0, 0});
-    draw(main_window, fg, {200, 200}, color::gray);
+    draw(main_window, fg, {200, 200});
 
     main_window.show();
     std::this_thread::sleep_for(5s);
@@ -1,6 +1,8 @@
+#include <sgfx/canvas.hpp>
 #include <sgfx/color.hpp>
 #include <sgfx/primitives.hpp>
-#include <sgfx/window.hpp>
+#include <sgfx/scale.hpp>
+#include <sgfx/screen.hpp>
 
 #include <array>
 #include <deque>
@@ -21,9 +23,10 @@ int main(int argc, char* argv[])
     using namespace sgfx;
     constexpr auto scale = 8;
     constexpr auto board_size = 64;
-    point origin{0, 0};
 
-    window main_window{scale * board_size, scale * board_size, "Snake!"};
+    auto screen = make_screen(scale * board_size, scale * board_size, "Snake!");
+    auto& main_window = *screen;
+    canvas frame{{board_size, board_size}};
     std::array<std::array<bool, board_size>, board_size> board{};
     std::deque<point> snake;
     point head{0, 0};
@@ -69,12 +72,14 @@ int main(int argc, char* argv[])
             }
         }
 
-        clear(main_window, color::black);
+        // render one pixel per cell and let the integer fast path of scale() blow it up to window size
+        clear(frame, color::black);
         for (int y = 0; y < (int) board.size(); ++y)
             for (int x = 0; x < (int) board[y].size(); ++x)
                 if (board[y][x])
-                    fill(main_window, {origin + scale * vec<int>{x, y}, {scale, scale}}, color::white);
-        fill(main_window, {origin + scale * (price - origin), {scale, scale}}, color::red);
+                    plot(frame, {x, y}, color::white);
+        plot(frame, price, color::red);
+        sgfx::scale(main_window, frame, {{0, 0}, main_window.size()}, scale_filter::nearest);
         main_window.show();
     }
     return 0;
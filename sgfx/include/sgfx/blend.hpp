@@ -0,0 +1,82 @@
+#pragma once
+
+#include <sgfx/color.hpp>
+#include <sgfx/primitive_types.hpp>
+#include <sgfx/widget.hpp>
+
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace sgfx {
+
+/**
+ * Ways of combining a translucent source color s (with alpha a) with a destination color d.
+ *
+ * All results are rounded to the nearest integer.
+ */
+enum class blend_mode {
+    source_over,  ///< d' = (s * a + d * (255 - a)) / 255
+    additive,     ///< d' = min(255, d + s * a / 255)
+    multiply,     ///< d' = d * f / 255, with f = (s * a + 255 * (255 - a)) / 255
+};
+
+/**
+ * Image with per-pixel alpha, to be blended onto a widget via draw().
+ */
+class rgba_image {
+  public:
+    using Color = color::rgba_color;
+    using Data = std::vector<Color>;
+
+    rgba_image(dimension dim, Data data) : size_{dim}, pixels_{std::move(data)}
+    {
+        if (static_cast<std::size_t>(dim.width * dim.height) != pixels_.size())
+            throw std::invalid_argument("Pixel dimensions don't match image data.");
+    }
+
+    explicit rgba_image(dimension size)
+        : size_{size}, pixels_(static_cast<unsigned>(size.width * size.height))
+    {
+    }
+
+    int width() const noexcept { return size_.width; }
+    int height() const noexcept { return size_.height; }
+    dimension size() const noexcept { return size_; }
+
+    Data& pixels() noexcept { return pixels_; }
+    Data const& pixels() const noexcept { return pixels_; }
+
+    Color& operator[](point const& p) { return pixels_[p.y * size_.width + p.x]; }
+    Color const& operator[](point const& p) const { return pixels_[p.y * size_.width + p.x]; }
+
+  private:
+    dimension size_;
+    Data pixels_;
+};
+
+void fill(widget& target, rectangle rect, color::rgba_color col, blend_mode mode);
+void draw(widget& target, rgba_image const& source, point top_left, blend_mode mode);
+
+/// Instruction set extensions the blending kernels can make use of.
+enum class simd_level {
+    scalar,  ///< portable reference implementation
+    sse2,    ///< vectorized fill()
+    ssse3,   ///< vectorized fill() and draw()
+    avx2,    ///< 256-bit fill() and draw()
+};
+
+/// Retrieves the instruction set currently used by the blending kernels.
+simd_level blend_simd_level() noexcept;
+
+/**
+ * Selects the instruction set to be used by the blending kernels, e.g. for benchmarking.
+ *
+ * The level is lowered to the best one supported by this CPU. By default the best supported one is used.
+ *
+ * @returns the level actually selected.
+ */
+simd_level set_blend_simd_level(simd_level level) noexcept;
+
+}  // namespace sgfx
@@ -3,8 +3,8 @@
 #include <sgfx/color.hpp>
 #include <sgfx/primitive_types.hpp>
 #include <sgfx/widget.hpp>
-#include <sgfx/window.hpp>
 #include <stdexcept>
+#include <vector>
 
 namespace sgfx {
 
@@ -29,10 +29,11 @@ class canvas : public widget {
     static canvas colored(dimension size, color::rgb_color col);
 
   private:
-    const dimension size_;
+    dimension size_;
     std::vector<color::rgb_color> pixels_;
 };
 
 void draw(widget& target, const canvas& img, point top_left);
+void draw(widget& target, const canvas& img, point top_left, rectangle clip);
 
 }  // namespace sgfx
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <sgfx/canvas.hpp>
+#include <sgfx/color.hpp>
+#include <sgfx/primitive_types.hpp>
+
+#include <cstddef>
+#include <deque>
+
+namespace sgfx {
+
+/**
+ * Hands out scratch canvases that live until the end of the current frame.
+ *
+ * Canvases are recycled by reset(). Once a frame has requested a set of sizes, later frames that
+ * request the same sizes are served without any heap allocation.
+ */
+class canvas_pool {
+  public:
+    /**
+     * Retrieves a scratch canvas of the given size with unspecified contents.
+     *
+     * The returned reference stays valid until the next call to reset().
+     */
+    canvas& acquire(dimension size);
+
+    /// Retrieves a scratch canvas of the given size, cleared to @p col.
+    canvas& acquire(dimension size, color::rgb_color col);
+
+    /// Reclaims all canvases handed out since the last reset, typically at the end of a frame.
+    void reset() noexcept { used_ = 0; }
+
+    /// Number of canvases handed out since the last reset().
+    std::size_t used() const noexcept { return used_; }
+
+    /// Number of canvases owned by the pool.
+    std::size_t capacity() const noexcept { return slots_.size(); }
+
+  private:
+    std::deque<canvas> slots_;  // [0, used_) are handed out, the rest is free
+    std::size_t used_ = 0;
+};
+
+}  // namespace sgfx
@@ -30,6 +30,44 @@ class rgb_color {
     std::array<std::uint8_t, 3> values_;
 };
 
+/**
+ * Color with an alpha channel, where an alpha of 0 is fully transparent and 255 fully opaque.
+ */
+class rgba_color {
+  public:
+    constexpr rgba_color() : rgba_color(0, 0, 0, 0) {}
+
+    constexpr rgba_color(std::uint8_t r, std::uint8_t g, std::uint8_t b, std::uint8_t a)
+        : values_{r, g, b, a}
+    {
+    }
+
+    constexpr rgba_color(rgb_color const& c, std::uint8_t a) : rgba_color(c.red(), c.green(), c.blue(), a) {}
+
+    constexpr auto& red() { return values_[0]; }
+    constexpr auto& green() { return values_[1]; }
+    constexpr auto& blue() { return values_[2]; }
+    constexpr auto& alpha() { return values_[3]; }
+
+    constexpr const auto& red() const { return values_[0]; }
+    constexpr const auto& green() const { return values_[1]; }
+    constexpr const auto& blue() const { return values_[2]; }
+    constexpr const auto& alpha() const { return values_[3]; }
+
+    constexpr rgb_color rgb() const noexcept { return rgb_color{red(), green(), blue()}; }
+
+    constexpr bool operator==(const rgba_color& other) const noexcept
+    {
+        return red() == other.red() && green() == other.green() && blue() == other.blue()
+               && alpha() == other.alpha();
+    }
+
+    constexpr bool operator!=(const rgba_color& other) const noexcept { return !(*this == other); }
+
+  private:
+    std::array<std::uint8_t, 4> values_;
+};
+
 inline constexpr const rgb_color white{255, 255, 255};
 inline constexpr const rgb_color black{0, 0, 0};
 inline constexpr const rgb_color red{255, 0, 0};
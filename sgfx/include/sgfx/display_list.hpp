@@ -0,0 +1,96 @@
+#pragma once
+
+#include <sgfx/canvas.hpp>
+#include <sgfx/color.hpp>
+#include <sgfx/image.hpp>
+#include <sgfx/primitive_types.hpp>
+#include <sgfx/thread_pool.hpp>
+#include <sgfx/widget.hpp>
+
+#include <cstdint>
+#include <variant>
+#include <vector>
+
+namespace sgfx {
+
+/**
+ * Records draw commands for a frame and rasterizes them later on in parallel.
+ *
+ * On submit() the recorded commands are binned into screen tiles and the tiles are rasterized
+ * concurrently on a thread_pool. Each tile replays its commands in recording order, so the result
+ * is pixel-identical to issuing the same calls in immediate mode.
+ *
+ * Images passed to draw() are referenced, not copied, and must outlive the next submit().
+ */
+class display_list {
+  public:
+    explicit display_list(int tile_size = 64) : tile_size_{tile_size} {}
+
+    void plot(point p, color::rgb_color col) { commands_.emplace_back(plot_cmd{p, col}); }
+    void clear(color::rgb_color col) { commands_.emplace_back(clear_cmd{col}); }
+    void hline(point p, std::uint16_t length, color::rgb_color col) { fill({p, {length, 1}}, col); }
+    void vline(point p, std::uint16_t length, color::rgb_color col) { fill({p, {1, length}}, col); }
+    void fill(rectangle rect, color::rgb_color col) { commands_.emplace_back(fill_cmd{rect, col}); }
+    void line(point p0, point p1, color::rgb_color col) { commands_.emplace_back(line_cmd{p0, p1, col}); }
+
+    void draw(canvas const& img, point top_left) { commands_.emplace_back(canvas_cmd{&img, top_left}); }
+    void draw(rle_image const& img, point top_left)
+    {
+        commands_.emplace_back(rle_cmd{&img, top_left, false, color::black});
+    }
+    void draw(rle_image const& img, point top_left, color::rgb_color colorkey)
+    {
+        commands_.emplace_back(rle_cmd{&img, top_left, true, colorkey});
+    }
+
+    std::size_t size() const noexcept { return commands_.size(); }
+    bool empty() const noexcept { return commands_.empty(); }
+
+    /// Discards all recorded commands, e.g. at the start of a new frame.
+    void reset() noexcept { commands_.clear(); }
+
+    /// Rasterizes all recorded commands into @p target using the given thread @p pool.
+    void submit(widget& target, thread_pool& pool);
+
+    /// Rasterizes all recorded commands into @p target using the shared thread pool.
+    void submit(widget& target) { submit(target, thread_pool::shared()); }
+
+  private:
+    struct plot_cmd {
+        point p;
+        color::rgb_color color;
+    };
+    struct clear_cmd {
+        color::rgb_color color;
+    };
+    struct fill_cmd {
+        rectangle rect;
+        color::rgb_color color;
+    };
+    struct line_cmd {
+        point p0;
+        point p1;
+        color::rgb_color color;
+    };
+    struct canvas_cmd {
+        canvas const* image;
+        point top_left;
+    };
+    struct rle_cmd {
+        rle_image const* image;
+        point top_left;
+        bool keyed;
+        color::rgb_color colorkey;
+    };
+    using command = std::variant<plot_cmd, clear_cmd, fill_cmd, line_cmd, canvas_cmd, rle_cmd>;
+
+    static rectangle bounds(command const& cmd, widget const& target);
+    static void rasterize(command const& cmd, widget& target, rectangle const& tile);
+
+  private:
+    int tile_size_;
+    std::vector<command> commands_;
+    std::vector<std::vector<std::uint32_t>> bins_;  // command indices per tile, reused across frames
+};
+
+}  // namespace sgfx
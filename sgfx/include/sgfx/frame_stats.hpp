@@ -0,0 +1,66 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iosfwd>
+#include <vector>
+
+namespace sgfx {
+
+/// Time spent in each phase of one frame.
+struct frame_timing {
+    using duration = std::chrono::steady_clock::duration;
+
+    duration render{};  ///< from the end of the previous frame until show(), i.e. the application's drawing
+    duration upload{};  ///< transferring the pixels to the GPU, as far as the CPU is involved
+    duration swap{};    ///< presenting the frame, including any wait for vertical sync
+    duration wait{};    ///< sleeping to meet the target frame rate
+
+    duration total() const noexcept { return render + upload + swap + wait; }
+};
+
+/// The phases of frame_timing, to pick the one to evaluate.
+enum class frame_phase { render, upload, swap, wait, total };
+
+/**
+ * Rolling statistics over the timings of the most recently shown frames.
+ */
+class frame_stats {
+  public:
+    using duration = frame_timing::duration;
+
+    /// Constructs statistics over the last @p window frames.
+    explicit frame_stats(std::size_t window = 600);
+
+    void record(frame_timing const& timing);
+    void reset() noexcept;
+
+    /// Number of frames the statistics are currently computed over.
+    std::size_t frames() const noexcept { return std::min(total_frames_, samples_.size()); }
+
+    /// Number of frames recorded since construction or the last reset().
+    std::size_t total_frames() const noexcept { return total_frames_; }
+
+    /// Timing of the most recently recorded frame, all zero if there is none.
+    frame_timing last() const noexcept;
+
+    /**
+     * Computes a percentile of the time spent in @p phase over the most recent frames.
+     *
+     * @param phase    the phase to evaluate.
+     * @param fraction the percentile as fraction in [0, 1], e.g. 0.99 for p99.
+     *
+     * @returns the duration not exceeded by the given fraction of frames, zero if there are none.
+     */
+    duration percentile(frame_phase phase, double fraction) const;
+
+    /// Writes p50, p99 and maximum of every phase and a histogram of frame times to @p out.
+    void dump(std::ostream& out) const;
+
+  private:
+    std::vector<frame_timing> samples_;  // ring buffer, the next sample goes to total_frames_ % size
+    std::size_t total_frames_ = 0;
+};
+
+}  // namespace sgfx
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <sgfx/color.hpp>
+#include <sgfx/key.hpp>
+#include <sgfx/screen.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sgfx {
+
+/**
+ * Offscreen framebuffer that needs neither a display nor OpenGL.
+ *
+ * Keyboard input is replayed from a script of per-frame key presses and releases,
+ * and each presented frame can optionally be dumped as PPM file.
+ */
+class headless : public screen {
+  public:
+	headless(std::uint16_t w, std::uint16_t h) : width_{w}, height_{h}, pixels_(w * h) {}
+
+	bool handle_events() override;
+	bool should_close() const override { return frame_ >= max_frames_; }
+	bool is_pressed(key_id key) const override;
+
+	void show() override;
+
+	std::uint16_t width() const noexcept override { return width_; }
+	std::uint16_t height() const noexcept override { return height_; }
+
+	std::vector<color::rgb_color>& pixels() noexcept override { return pixels_; }
+	const std::vector<color::rgb_color>& pixels() const noexcept override { return pixels_; }
+
+	/// Number of frames presented so far.
+	unsigned frame() const noexcept { return frame_; }
+
+	/// Lets should_close() return true once @p count frames have been presented.
+	void set_max_frames(unsigned count) noexcept { max_frames_ = count; }
+
+	/**
+	 * Dumps every presented frame to a PPM file named by the printf-style @p pattern (e.g. "f%04u.ppm").
+	 *
+	 * @throws std::runtime_error unless the pattern has exactly one %u or %d conversion, optionally with a
+	 *         zero flag and a width, for the frame number. Other than that, only "%%" is allowed.
+	 */
+	void set_frame_dump(std::string pattern);
+
+	/// Schedules @p key to be pressed (or released) from frame @p frame on.
+	void script(unsigned frame, key_id key, bool pressed);
+
+	/**
+	 * Loads an input script from the file at @p path.
+	 *
+	 * Each line reads "<frame> press|release <key>", where key is either a single character
+	 * or one of space, escape, left, right, up, down, backspace. Lines starting with '#' are ignored.
+	 */
+	void load_script(std::string const& path);
+
+  private:
+	struct input_event {
+		unsigned frame;
+		key_id key;
+		bool pressed;
+	};
+
+	const std::uint16_t width_, height_;
+	std::vector<color::rgb_color> pixels_;
+
+	unsigned frame_ = 0;
+	unsigned max_frames_ = std::numeric_limits<unsigned>::max();
+	std::string dump_pattern_;
+
+	std::vector<input_event> script_;  // ordered by frame
+	std::size_t next_event_ = 0;
+	std::vector<key_id> pressed_;
+};
+
+}  // namespace sgfx
@@ -3,6 +3,7 @@
 
 #include <sgfx/canvas.hpp>
 #include <sgfx/color.hpp>
+#include <sgfx/ppm.hpp>
 #include <sgfx/primitive_types.hpp>
 #include <sgfx/primitives.hpp>
 
@@ -14,7 +15,7 @@ namespace sgfx {
 // would be better to use std::filesystem::path, but support seems to be lacking on some platforms(...) and it
 // seems like not everbody is willing to use the VM xD
 canvas load_ppm(const std::string& path);
-void save_ppm(widget const& source, const std::string& path);
+void save_ppm(widget const& source, const std::string& path, ppm::Format format = ppm::Format::Plain);
 
 class rle_image {
   public:
@@ -24,9 +25,17 @@ class rle_image {
     };
     using Row = std::vector<Run>;
 
+    /// Decodes an image in the format written by save_rle().
     static rle_image load(std::string const& data);
 
-    static std::vector<Run> decodeLine(uint8_t const* line, size_t width);
+    /**
+     * Decodes the row starting at @p line and advances @p line past it.
+     *
+     * @throws std::runtime_error if the row extends beyond @p end.
+     */
+    static Row decodeLine(uint8_t const*& line, uint8_t const* end);
+    /// Appends the encoded row of the @p count pixels at @p pixels, 3 bytes each, to @p output.
+    static void encodeLine(uint8_t const* pixels, size_t count, std::vector<uint8_t>& output);
     static void encodeLine(std::vector<uint8_t> const& input, std::vector<uint8_t>& output);
 
     rle_image(dimension dim, std::vector<Row> rows) : dim_{dim}, rows_{move(rows)} {}
@@ -47,6 +56,8 @@ void save_rle(const rle_image& source, const std::string& path);
 rle_image rle_encode(widget& source);
 void draw(widget& target, const rle_image& source, point top_left);
 void draw(widget& target, const rle_image& source, point top_left, color::rgb_color colorkey);
+void draw(widget& target, const rle_image& source, point top_left, rectangle clip);
+void draw(widget& target, const rle_image& source, point top_left, color::rgb_color colorkey, rectangle clip);
 
 }  // namespace sgfx
 
@@ -1,18 +1,26 @@
 #pragma once
 
-#include <GL/glew.h>
-#include <GLFW/glfw3.h>
-
 namespace sgfx {
 
 // TODO: should be `enum class key { ... };`
 
+/**
+ * Identifies a keyboard key.
+ *
+ * The values match the GLFW key codes, i.e. printable keys are identified by their (upper case)
+ * ASCII code, so that this header does not depend on GLFW.
+ */
 class key_id {
   public:
 	explicit constexpr key_id(char c) : id_{(c >= 'a' && c <= 'z') ? (c - 'a' + 'A') : c} {}
 
 	explicit constexpr key_id(int id) : id_{id} {}
 
+	constexpr int id() const noexcept { return id_; }
+
+	constexpr bool operator==(key_id const& other) const noexcept { return id_ == other.id_; }
+	constexpr bool operator!=(key_id const& other) const noexcept { return id_ != other.id_; }
+
   private:
 	int id_;
 	friend class window;
@@ -21,22 +29,22 @@ class key_id {
 namespace key {
 
 // do we need this?
-inline constexpr const key_id space{GLFW_KEY_SPACE};
+inline constexpr const key_id space{32};  // GLFW_KEY_SPACE
 
 
-inline constexpr const key_id escape{GLFW_KEY_ESCAPE};
+inline constexpr const key_id escape{256};  // GLFW_KEY_ESCAPE
 
 // do we need this?
-inline constexpr const key_id left{GLFW_KEY_LEFT};
-inline constexpr const key_id right{GLFW_KEY_RIGHT};
+inline constexpr const key_id left{263};   // GLFW_KEY_LEFT
+inline constexpr const key_id right{262};  // GLFW_KEY_RIGHT
 
-inline constexpr const key_id up{GLFW_KEY_UP};
-inline constexpr const key_id down{GLFW_KEY_DOWN};
+inline constexpr const key_id up{265};    // GLFW_KEY_UP
+inline constexpr const key_id down{264};  // GLFW_KEY_DOWN
 
 // added
-inline constexpr const key_id backspace{GLFW_KEY_BACKSPACE};
-inline constexpr const key_id wkey{GLFW_KEY_W};
-inline constexpr const key_id skey{GLFW_KEY_S};
+inline constexpr const key_id backspace{259};  // GLFW_KEY_BACKSPACE
+inline constexpr const key_id wkey{'W'};       // GLFW_KEY_W
+inline constexpr const key_id skey{'S'};       // GLFW_KEY_S
 
 }  // namespace key
 
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace sgfx {
+
+/// Hardware events perf_counters can count.
+enum class perf_event { cycles, instructions, branch_misses, cache_misses };
+
+constexpr std::size_t perf_event_count = 4;
+
+/// Short name of @p event, e.g. "branch-misses".
+char const* name(perf_event event) noexcept;
+
+/**
+ * Event counts read from perf_counters, or the difference of two such readings.
+ */
+struct perf_sample {
+    std::array<std::uint64_t, perf_event_count> counts{};
+    unsigned counted = 0;  ///< bitmask of the events that could be counted, bit i being perf_event i
+
+    bool has(perf_event event) const noexcept { return counted & (1u << static_cast<unsigned>(event)); }
+    std::uint64_t operator[](perf_event event) const noexcept
+    {
+        return counts[static_cast<std::size_t>(event)];
+    }
+
+    perf_sample& operator+=(perf_sample const& other) noexcept;
+    perf_sample& operator-=(perf_sample const& other) noexcept;
+};
+
+inline perf_sample operator+(perf_sample a, perf_sample const& b) noexcept { return a += b; }
+inline perf_sample operator-(perf_sample a, perf_sample const& b) noexcept { return a -= b; }
+
+/**
+ * Counts CPU cycles, retired instructions, branch misses and last level cache misses of the calling
+ * thread and of all threads it starts afterwards, in user space only.
+ *
+ * Uses perf_event_open() on Linux. Events that cannot be opened, be it on other platforms, due to
+ * perf_event_paranoid or a container's seccomp profile, are simply not counted and read as zero, which
+ * perf_sample::has() tells apart.
+ */
+class perf_counters {
+  public:
+    perf_counters();
+    ~perf_counters();
+
+    perf_counters(perf_counters const&) = delete;
+    perf_counters& operator=(perf_counters const&) = delete;
+
+    /// Whether any event is counted at all.
+    bool available() const noexcept { return counted_ != 0; }
+
+    /// Reads the counts accumulated since construction.
+    perf_sample read() const noexcept;
+
+  private:
+    std::array<int, perf_event_count> fds_;
+    unsigned counted_ = 0;
+};
+
+}  // namespace sgfx
@@ -1,54 +1,108 @@
+#pragma once
+
 #include <sgfx/canvas.hpp>
 #include <sgfx/color.hpp>
 #include <sgfx/primitive_types.hpp>
+#include <sgfx/thread_pool.hpp>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string_view>
+#include <vector>
 
 namespace sgfx::ppm {
 
+/// Encodings of the pixel data of PPM images.
+enum class Format {
+    Plain,   ///< P3, decimal numbers in plain text
+    Binary,  ///< P6, one byte per channel
+};
+
+/// The properties of a PPM image given by its header.
+struct Header {
+    Format format;
+    dimension size;
+    unsigned maximumColorValue;
+    std::size_t length;  ///< number of bytes preceding the pixel data
+};
+
+/**
+ * Parses P3 (plain text) and P6 (binary) PPM images.
+ *
+ * The lexer scans the source in place, so parsing performs no allocation apart from the pixel data.
+ * Pixel data of large images is split at line breaks into chunks, which are parsed concurrently.
+ */
 class Parser {
   public:
-    canvas parseString(std::string const& data);
+    /// Parses @p data, using the shared thread pool for large images.
+    canvas parseString(std::string_view data);
 
-  private:
-    enum class Token {
-        Invalid,
-        Number,
-        Comment,
-        Magic,
-        Eof,
-    };
+    /// Parses @p data, using @p pool for large images.
+    canvas parseString(std::string_view data, thread_pool& pool);
 
-    struct TokenInfo {
-        Token token;
-        std::string literal;
-    };
+    /**
+     * Parses just the header at the beginning of @p data, e.g. to process the pixel data as it arrives.
+     *
+     * @returns the header, or nothing if @p data ends before the header does.
+     * @throws std::runtime_error if @p data does not start with a valid header.
+     */
+    std::optional<Header> parseHeader(std::string_view data);
 
+  private:
     class FileFormatError : public std::runtime_error {
       public:
         FileFormatError(std::string const& msg) : std::runtime_error{msg} {}
     };
 
-    void fatalSyntaxError(std::string const& diagnosticMessage);
+    [[noreturn]] void fatalSyntaxError(std::string const& diagnosticMessage);
 
     // lexical analysis
-    bool eof() const noexcept { return !source_ || offset_ >= source_->size() || currentToken_.token == Token::Eof; }
-    char currentChar() const noexcept;
-    char peekChar() const noexcept;
-    char nextChar() noexcept;
-    TokenInfo currentToken() const noexcept { return currentToken_; }
-    TokenInfo consumeToken();
-    std::string consumeToken(Token token);
+    bool eof() const noexcept { return current_ == end_; }
+    void skipWhitespaceAndComments() noexcept;
 
     // syntactical analysis
-    std::string parseMagic();
+    canvas parse(std::string_view data, thread_pool* pool);
+    bool parsePixelsParallel(color::rgb_color* pixels, std::size_t count, thread_pool& pool);
+    void parseChannels(color::rgb_color* pixels, std::size_t first, std::size_t count);
+    void parsePixels(color::rgb_color* pixels, std::size_t count);
+    Format parseMagic();
     dimension parseDimension();
+    std::size_t parsePixelsFast(color::rgb_color* pixels, std::size_t count) noexcept;
     color::rgb_color parsePixel();
-    int parseNumber();
+    std::uint8_t parseChannel();
+    unsigned parseNumber();
+
+  private:
+    char const* current_ = nullptr;
+    char const* end_ = nullptr;
+};
+
+/**
+ * Writes PPM images.
+ *
+ * Plain text output is rendered from a table of all formatted channel values into a contiguous buffer,
+ * which is handed out in large blocks rather than character by character.
+ */
+class Writer {
+  public:
+    /// Receives the encoded image block by block.
+    using Sink = std::function<void(char const* data, std::size_t size)>;
+
+    explicit Writer(Format format = Format::Plain, std::size_t blockSize = 1 << 20);
+
+    /**
+     * Encodes an image of size @p dim.
+     *
+     * @param channels the pixels, as red, green and blue byte each, row by row.
+     * @param sink     invoked with each encoded block in order.
+     */
+    void write(dimension dim, std::uint8_t const* channels, Sink const& sink);
 
   private:
-    std::string const* source_ = nullptr;
-    std::size_t offset_{0};
-    TokenInfo currentToken_{Token::Invalid, ""};
+    Format format_;
+    std::size_t pixelsPerBlock_;
+    std::vector<char> buffer_;
 };
 
 }  // namespace sgfx::ppm
@@ -132,6 +132,8 @@ struct rectangle {
     constexpr int bottom() const noexcept { return top_left.y + size.height; }
     constexpr int left() const noexcept { return top_left.x; }
     constexpr int right() const noexcept { return top_left.x + size.width; }
+
+    constexpr bool empty() const noexcept { return size.width <= 0 || size.height <= 0; }
 };
 
 /**
@@ -145,4 +147,22 @@ constexpr bool intersects(rectangle const& a, rectangle const& b)
     return a.left() < b.right() && b.left() < a.right() && a.top() < b.bottom() && b.top() < a.bottom();
 }
 
+/**
+ * Computes the intersection of rectangle a and rectangle b.
+ *
+ * @returns the overlapping area, or an empty rectangle if they're not intersecting.
+ */
+constexpr rectangle intersection(rectangle const& a, rectangle const& b)
+{
+    int const left = a.left() > b.left() ? a.left() : b.left();
+    int const top = a.top() > b.top() ? a.top() : b.top();
+    int const right = a.right() < b.right() ? a.right() : b.right();
+    int const bottom = a.bottom() < b.bottom() ? a.bottom() : b.bottom();
+
+    if (left >= right || top >= bottom)
+        return rectangle{{left, top}, {0, 0}};
+
+    return rectangle{{left, top}, {right - left, bottom - top}};
+}
+
 }  // namespace sgfx
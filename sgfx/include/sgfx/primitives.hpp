@@ -4,7 +4,10 @@
 #include <sgfx/primitive_types.hpp>
 #include <sgfx/widget.hpp>
 
+#include <cstddef>
 #include <cstdint>
+#include <utility>
+#include <vector>
 
 namespace sgfx {
 
@@ -16,7 +19,28 @@ void hline(widget& target, point p, std::uint16_t length, color::rgb_color col);
 void vline(widget& target, point p, std::uint16_t length, color::rgb_color col);
 
 void fill(widget& target, rectangle rect, color::rgb_color col);
+void fill(widget& target, rectangle rect, color::rgb_color col, rectangle clip);
 
 void line(widget& target, point p0, point p1, color::rgb_color col);
+void line(widget& target, point p0, point p1, color::rgb_color col, rectangle clip);
+
+/**
+ * Computes the smallest rectangle containing both @p p0 and @p p1, clipped to @p clip.
+ *
+ * Unlike the unclipped box, the result cannot overflow an int, however far apart the points are.
+ */
+rectangle bounding_box(point p0, point p1, rectangle const& clip);
+
+/**
+ * Draws a batch of line segments (e.g. a wireframe) in one go.
+ *
+ * Each segment is drawn exactly as line() would draw it, clipped to the target.
+ */
+void lines(widget& target, std::pair<point, point> const* segments, std::size_t count, color::rgb_color col);
+
+inline void lines(widget& target, std::vector<std::pair<point, point>> const& segments, color::rgb_color col)
+{
+	lines(target, segments.data(), segments.size(), col);
+}
 
 }  // namespace sgfx
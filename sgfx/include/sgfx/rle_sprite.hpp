@@ -0,0 +1,68 @@
+#pragma once
+
+#include <sgfx/color.hpp>
+#include <sgfx/image.hpp>
+#include <sgfx/primitive_types.hpp>
+#include <sgfx/widget.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sgfx {
+
+/**
+ * Run-length encoded image with transparent parts, for drawing colorkeyed sprites.
+ *
+ * Each row is a sequence of spans, made of a number of transparent pixels to skip, followed by a number
+ * of opaque pixels that are stored verbatim. Drawing thus jumps over transparent parts and copies opaque
+ * ones straight out of the encoded data, without looking at individual pixels.
+ *
+ * An encoded row is a 16-bit little-endian span count, followed by the spans. Each span is one byte
+ * skip count, one byte pixel count and that many RGB triples. Files written by save_rle_sprite() hold the
+ * 16-bit little-endian width and height, followed by all encoded rows.
+ */
+class rle_sprite {
+  public:
+    rle_sprite() = default;
+
+    /// Converts @p image, leaving out all pixels of color @p colorkey.
+    rle_sprite(rle_image const& image, color::rgb_color colorkey);
+
+    /// Converts @p image, leaving out all pixels of color @p colorkey.
+    rle_sprite(widget const& image, color::rgb_color colorkey);
+
+    /**
+     * Decodes a sprite in the format written by save_rle_sprite().
+     *
+     * @throws std::runtime_error if @p data is malformed.
+     */
+    static rle_sprite load(std::string const& data);
+
+    /// Appends the encoded row of the @p count pixels at @p pixels, 3 bytes each, to @p output.
+    static void encode_row(std::uint8_t const* pixels, std::size_t count, color::rgb_color colorkey,
+                           std::vector<std::uint8_t>& output);
+
+    dimension size() const noexcept { return size_; }
+
+    /// Encoded rows, see encode_row().
+    std::vector<std::uint8_t> const& data() const noexcept { return data_; }
+
+    /// Start of the encoded row @p y.
+    std::uint8_t const* row(std::size_t y) const noexcept { return data_.data() + rows_[y]; }
+
+  private:
+    rle_sprite(dimension size, std::vector<std::uint8_t> data);
+
+    dimension size_{0, 0};
+    std::vector<std::uint8_t> data_;
+    std::vector<std::size_t> rows_;  // offset of each row into data_
+};
+
+rle_sprite load_rle_sprite(std::string const& path);
+void save_rle_sprite(rle_sprite const& source, std::string const& path);
+void draw(widget& target, rle_sprite const& source, point top_left);
+void draw(widget& target, rle_sprite const& source, point top_left, rectangle clip);
+
+}  // namespace sgfx
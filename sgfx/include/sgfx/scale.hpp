@@ -0,0 +1,42 @@
+#pragma once
+
+#include <sgfx/canvas.hpp>
+#include <sgfx/primitive_types.hpp>
+#include <sgfx/widget.hpp>
+
+namespace sgfx {
+
+/// Resampling filters supported by scale().
+enum class scale_filter {
+    nearest,   ///< picks the closest source pixel; exact pixel replication for integer factors
+    bilinear,  ///< interpolates between the four closest source pixels
+};
+
+/**
+ * Resamples @p source to @p size.
+ *
+ * Pixel centers are aligned, i.e. the image is stretched such that its edges coincide.
+ * Upscaling by integer factors with scale_filter::nearest takes a dedicated fast path.
+ *
+ * @param source the image to resample.
+ * @param size   dimension of the resulting image.
+ * @param filter resampling filter to use.
+ *
+ * @returns the resampled image.
+ */
+canvas scale(canvas const& source, dimension size, scale_filter filter = scale_filter::bilinear);
+
+/**
+ * Resamples @p source into the given @p area of @p target without any intermediate image.
+ *
+ * Parts of @p area outside @p target are clipped, without affecting how the visible part is sampled.
+ *
+ * @param target the widget to draw into.
+ * @param source the image to resample.
+ * @param area   the region of @p target the source image is stretched onto.
+ * @param filter resampling filter to use.
+ */
+void scale(widget& target, canvas const& source, rectangle area,
+           scale_filter filter = scale_filter::bilinear);
+
+}  // namespace sgfx
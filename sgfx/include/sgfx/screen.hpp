@@ -0,0 +1,48 @@
+#pragma once
+
+#include <sgfx/key.hpp>
+#include <sgfx/widget.hpp>
+
+#include <cstdint>
+#include <memory>
+
+namespace sgfx {
+
+/**
+ * screen provides an abstract interface to the widgets frames are presented on,
+ * i.e. window and headless.
+ */
+class screen : public widget {
+  public:
+	virtual bool handle_events() = 0;
+	virtual bool should_close() const = 0;
+	virtual bool is_pressed(key_id key) const = 0;
+
+	virtual void show() = 0;
+};
+
+/**
+ * Creates the screen to render to, chosen at runtime.
+ *
+ * A window is created, unless the environment variable SGFX_BACKEND is set to "headless"
+ * or sgfx was built without window support. A window is configured from the environment via:
+ *
+ * <ul>
+ *   <li>SGFX_SWAP_INTERVAL: vertical retraces to wait for per frame (see window::set_swap_interval())</li>
+ *   <li>SGFX_TARGET_FPS: frame rate to pace show() to (see window::set_target_frame_rate())</li>
+ *   <li>SGFX_FRAME_STATS: if set, frame time statistics are written to standard error on exit</li>
+ * </ul>
+ *
+ * A headless screen is configured from the environment as well:
+ *
+ * <ul>
+ *   <li>SGFX_FRAMES: number of frames after which should_close() returns true</li>
+ *   <li>SGFX_INPUT: path to an input script (see headless::load_script())</li>
+ *   <li>SGFX_DUMP: path with one %u for the frame number (e.g. "frame%04u.ppm") to dump frames to</li>
+ * </ul>
+ *
+ * With either, SGFX_TRACE names a file to write a trace of the frames to on exit (see start_tracing()).
+ */
+std::unique_ptr<screen> make_screen(std::uint16_t w, std::uint16_t h, const char* title = "Default");
+
+}  // namespace sgfx
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sgfx {
+
+/**
+ * Fixed-size work-stealing thread pool.
+ *
+ * Each worker owns a queue of task indices. A worker first drains its own queue and then steals
+ * from the other queues, so uneven work (e.g. busy screen tiles) still keeps all cores busy.
+ */
+class thread_pool {
+  public:
+    using task = std::function<void(std::size_t)>;
+
+    /// Constructs a pool of @p concurrency threads, including the thread calling parallel_for().
+    explicit thread_pool(unsigned concurrency = std::thread::hardware_concurrency());
+    ~thread_pool();
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    /// Number of threads participating in parallel_for(), including the calling thread.
+    unsigned concurrency() const noexcept { return static_cast<unsigned>(queues_.size()); }
+
+    /**
+     * Invokes @p fn(i) for every i in [0, count) and blocks until all invocations finished.
+     *
+     * The first exception thrown by any invocation is rethrown on the calling thread.
+     *
+     * Calls from within a task of this pool run the loop inline on the calling thread, as waiting for
+     * the workers would deadlock. Calls from a task of another pool are parallelized as usual, so pools
+     * must not call into each other in a cycle.
+     */
+    void parallel_for(std::size_t count, task const& fn);
+
+    /**
+     * Retrieves a process-wide pool sized to the hardware concurrency.
+     *
+     * Functions like load_ppm() use it internally; calling them from its own tasks runs them inline
+     * (see parallel_for()).
+     */
+    static thread_pool& shared();
+
+  private:
+    struct queue {
+        std::mutex lock;
+        std::deque<std::size_t> items;
+    };
+
+    void worker(std::size_t id);
+    bool run_one(std::size_t id);
+
+  private:
+    std::vector<std::unique_ptr<queue>> queues_;  // last queue belongs to the calling thread
+    std::vector<std::thread> threads_;
+
+    std::mutex submit_;  // serializes parallel_for() calls
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::condition_variable done_;
+    task const* task_ = nullptr;
+    std::size_t generation_ = 0;
+    bool quit_ = false;
+    std::atomic<std::size_t> pending_{0};
+    std::exception_ptr error_;
+};
+
+}  // namespace sgfx
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+namespace sgfx {
+
+/**
+ * Starts recording trace spans of all threads, e.g. to find pipeline stalls or frame hitches on a timeline.
+ *
+ * Spans are kept in a ring buffer per thread, i.e. only the most recent ones are retained on long runs.
+ * They are written to @p path in the Chrome trace event format, which chrome://tracing and Perfetto open,
+ * by stop_tracing() or at the latest on exit.
+ */
+void start_tracing(std::string path);
+
+/// Stops recording and writes the spans recorded so far, if tracing was started at all.
+void stop_tracing();
+
+/// Whether spans are currently recorded.
+bool tracing() noexcept;
+
+/**
+ * Records a span from @p begin to @p end on the calling thread, if tracing.
+ *
+ * @p name and @p category are kept by pointer, i.e. they must be string literals or otherwise outlive
+ * the trace.
+ */
+void record_span(char const* name, char const* category, std::chrono::steady_clock::time_point begin,
+                 std::chrono::steady_clock::time_point end) noexcept;
+
+/**
+ * Records the span of its own lifetime, if tracing when it is constructed.
+ *
+ * Costs little more than a function call while not tracing.
+ */
+class trace_span {
+  public:
+    explicit trace_span(char const* name, char const* category = "sgfx") noexcept
+        : name_{name}, category_{category}
+    {
+        if (tracing())
+            begin_ = std::chrono::steady_clock::now();
+    }
+
+    ~trace_span()
+    {
+        if (begin_ != std::chrono::steady_clock::time_point{})
+            record_span(name_, category_, begin_, std::chrono::steady_clock::now());
+    }
+
+    trace_span(trace_span const&) = delete;
+    trace_span& operator=(trace_span const&) = delete;
+
+  private:
+    char const* name_;
+    char const* category_;
+    std::chrono::steady_clock::time_point begin_{};
+};
+
+}  // namespace sgfx
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <sgfx/color.hpp>
 #include <sgfx/primitive_types.hpp>
 
 #include <cstdint>
@@ -23,6 +24,14 @@ class widget {
 
 	dimension size() const noexcept { return {width(), height()}; }
 
+	/**
+	 * Reports that the pixels within @p area have been modified.
+	 *
+	 * All drawing primitives report the area they touched, so that widgets like window can
+	 * restrict their work to what actually changed. The default implementation ignores it.
+	 */
+	virtual void damage(rectangle const& area) {}
+
 	color::rgb_color& operator[](point const& p) { return pixels()[p.y * width() + p.x]; }
 	color::rgb_color const& operator[](point const& p) const { return pixels()[p.y * width() + p.x]; }
 };
@@ -1,35 +1,39 @@
 #pragma once
 
 #include <sgfx/color.hpp>
+#include <sgfx/frame_stats.hpp>
 #include <sgfx/key.hpp>
-#include <sgfx/widget.hpp>
+#include <sgfx/screen.hpp>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+#include <chrono>
+#include <mutex>
 #include <vector>
 
 #include <cctype>
+#include <cstddef>
 #include <cstdint>
 
 namespace sgfx {
 
-class window : public widget {
+class window : public screen {
   public:
 	window(std::uint16_t w, std::uint16_t h) : window(w, h, "Default") {}
 
 	window(std::uint16_t w, std::uint16_t h, const char* title);
 
-	~window();
+	~window() override;
 
 	window(const window&) = delete;
 	window& operator=(const window&) = delete;
 
-	bool handle_events();
-	bool should_close() const;
-	bool is_pressed(key_id key) const;
+	bool handle_events() override;
+	bool should_close() const override;
+	bool is_pressed(key_id key) const override;
 
-	void show() const;
+	void show() override;
 
 	std::uint16_t width() const noexcept override { return width_; }
 	std::uint16_t height() const noexcept override { return height_; }
@@ -37,6 +41,78 @@ class window : public widget {
 	std::vector<color::rgb_color>& pixels() noexcept override { return pixels_; }
 	const std::vector<color::rgb_color>& pixels() const noexcept override { return pixels_; }
 
+	void damage(rectangle const& area) override;
+
+	/**
+	 * Enables or disables damage tracking.
+	 *
+	 * With damage tracking enabled, show() only uploads the rows touched since the previous show().
+	 * Any modification made through pixels() directly must then be reported via damage().
+	 * With damage tracking disabled (the default), show() always uploads the full frame.
+	 */
+	void set_damage_tracking(bool enabled);
+	bool damage_tracking() const noexcept { return damage_tracking_; }
+
+	/// Sets the damaged fraction of the frame (0..1) above which show() uploads the full frame.
+	void set_full_upload_threshold(float coverage) noexcept { full_upload_threshold_ = coverage; }
+
+	/// Number of pixel bytes uploaded to the GPU by the most recent show().
+	std::size_t uploaded_bytes() const noexcept { return uploaded_bytes_; }
+
+	/**
+	 * Switches show() to upload through @p count pixel buffer objects used in rotation.
+	 *
+	 * The texture upload then is an asynchronous DMA transfer out of a buffer object, while the CPU
+	 * already fills the next buffer object for the following frame. A count of 0 selects the
+	 * synchronous upload directly from pixels().
+	 *
+	 * @retval true the requested upload path is in use.
+	 * @retval false pixel buffer objects are not supported, the synchronous path stays in use.
+	 */
+	bool set_pixel_buffer_count(unsigned count);
+	unsigned pixel_buffer_count() const noexcept { return static_cast<unsigned>(pbo_ids_.size()); }
+
+	/**
+	 * Maps the pixel buffer object that the next show() uploads from.
+	 *
+	 * This allows rendering a frame directly into mapped GPU memory. The returned buffer holds
+	 * width() * height() pixels with undefined contents and must be completely written before the
+	 * next show(), which then uploads it instead of pixels().
+	 *
+	 * @returns pointer to the mapped pixels, or nullptr if no pixel buffer objects are in use.
+	 */
+	color::rgb_color* map_pixel_buffer();
+
+	/**
+	 * Sets the number of vertical retraces show() waits for before presenting a frame.
+	 *
+	 * An interval of 1 synchronizes to the display's refresh rate (vsync), 0 presents immediately.
+	 * Until this is called, the driver's default applies.
+	 */
+	void set_swap_interval(int interval);
+
+	/**
+	 * Limits the frame rate by letting show() sleep until the next frame is due.
+	 *
+	 * Frames are scheduled at fixed intervals. A frame that is late restarts the schedule instead of
+	 * making subsequent frames catch up. A rate of 0 (the default) disables pacing.
+	 */
+	void set_target_frame_rate(double fps) noexcept;
+	double target_frame_rate() const noexcept { return target_frame_rate_; }
+
+	/// Timings of the most recently shown frames.
+	frame_stats const& statistics() const noexcept { return stats_; }
+	frame_stats& statistics() noexcept { return stats_; }
+
+	/// Writes the frame statistics to standard error when the window gets destroyed.
+	void set_statistics_dump_on_close(bool enabled) noexcept { dump_statistics_ = enabled; }
+
+  private:
+	void collect_damaged_bands();
+	void reset_damage();
+	void upload_bands();
+	color::rgb_color* map_next_pixel_buffer();
+
   private:
 	GLFWwindow* wnd_;
 	GLuint texture_id_;
@@ -45,6 +121,27 @@ class window : public widget {
 
 	const std::uint16_t width_, height_;
 	std::vector<color::rgb_color> pixels_;
+
+	// damaged span [damage_left_[y], damage_right_[y]) per row, empty if left >= right
+	bool damage_tracking_ = false;
+	float full_upload_threshold_ = 0.5f;
+	std::mutex damage_lock_;  // damage() may be called concurrently, e.g. by display_list
+	std::vector<int> damage_left_;
+	std::vector<int> damage_right_;
+	std::vector<rectangle> bands_;  // areas to upload on the next show()
+	std::size_t uploaded_bytes_ = 0;
+
+	std::vector<GLuint> pbo_ids_;
+	std::size_t next_pbo_ = 0;
+	color::rgb_color* mapped_ = nullptr;  // user-mapped pixel buffer for the next show(), if any
+
+	using clock = std::chrono::steady_clock;
+	double target_frame_rate_ = 0;
+	clock::duration frame_interval_{};
+	clock::time_point next_frame_{};  // when the next paced frame is due
+	clock::time_point frame_end_{};   // when the previous show() returned
+	frame_stats stats_;
+	bool dump_statistics_ = false;
 };
 
 }  // namespace sgfx
@@ -0,0 +1,425 @@
+#include <sgfx/blend.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#	define SGFX_BLEND_X86 1
+#	include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace sgfx {
+
+namespace {
+
+static_assert(sizeof(color::rgb_color) == 3, "rgb_color must be tightly packed.");
+static_assert(sizeof(color::rgba_color) == 4, "rgba_color must be tightly packed.");
+
+using byte = uint8_t;
+
+/// Computes x / 255 rounded to the nearest integer, exact for x in [0, 255 * 255].
+constexpr unsigned div255(unsigned x)
+{
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+/**
+ * Per-channel constants of a fill.
+ *
+ * additive: d' = min(255, d + offset[c]), otherwise d' = div255(d * factor[c] + addend[c]).
+ */
+struct fill_params {
+	bool additive;
+	uint16_t factor[3];
+	uint16_t addend[3];
+	uint8_t offset[3];
+};
+
+fill_params make_fill_params(color::rgba_color col, blend_mode mode)
+{
+	unsigned const a = col.alpha();
+	unsigned const s[3] = {col.red(), col.green(), col.blue()};
+
+	fill_params p{mode == blend_mode::additive, {}, {}, {}};
+	for (int c = 0; c < 3; ++c)
+	{
+		switch (mode)
+		{
+			case blend_mode::source_over:
+				p.factor[c] = static_cast<uint16_t>(255 - a);
+				p.addend[c] = static_cast<uint16_t>(s[c] * a);
+				break;
+			case blend_mode::additive:
+				p.offset[c] = static_cast<uint8_t>(div255(s[c] * a));
+				break;
+			case blend_mode::multiply:
+				p.factor[c] = static_cast<uint16_t>(div255(s[c] * a + 255 * (255 - a)));
+				p.addend[c] = 0;
+				break;
+		}
+	}
+	return p;
+}
+
+// {{{ scalar reference kernels
+/// Fills @p count pixels starting at @p d.
+void fill_row_scalar(byte* d, size_t count, fill_params const& p)
+{
+	for (byte* const end = d + 3 * count; d != end;)
+		for (int c = 0; c < 3; ++c, ++d)
+			*d = p.additive ? static_cast<byte>(min(255u, unsigned{*d} + p.offset[c]))
+							: static_cast<byte>(div255(*d * p.factor[c] + p.addend[c]));
+}
+
+/// Blends @p count pixels of @p s onto @p d.
+void draw_row_scalar(byte* d, color::rgba_color const* s, size_t count, blend_mode mode)
+{
+	for (color::rgba_color const* const end = s + count; s != end; ++s)
+	{
+		unsigned const a = s->alpha();
+		unsigned const src[3] = {s->red(), s->green(), s->blue()};
+		for (int c = 0; c < 3; ++c, ++d)
+		{
+			switch (mode)
+			{
+				case blend_mode::source_over:
+					*d = static_cast<byte>(div255(src[c] * a + *d * (255 - a)));
+					break;
+				case blend_mode::additive:
+					*d = static_cast<byte>(min(255u, *d + div255(src[c] * a)));
+					break;
+				case blend_mode::multiply:
+					*d = static_cast<byte>(div255(*d * div255(src[c] * a + 255 * (255 - a))));
+					break;
+			}
+		}
+	}
+}
+// }}}
+
+#if defined(SGFX_BLEND_X86)
+// {{{ SSE2 / SSSE3 kernels
+inline __m128i div255(__m128i x)
+{
+	x = _mm_add_epi16(x, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+/// Fills 16 pixels (48 bytes) per iteration, using the channel pattern that repeats every 48 bytes.
+size_t fill_row_sse2(byte* d, size_t count, fill_params const& p)
+{
+	alignas(16) uint16_t factor[48];
+	alignas(16) uint16_t addend[48];
+	alignas(16) uint8_t offset[48];
+	for (int i = 0; i < 48; ++i)
+	{
+		factor[i] = p.factor[i % 3];
+		addend[i] = p.addend[i % 3];
+		offset[i] = p.offset[i % 3];
+	}
+
+	__m128i const zero = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16, d += 48)
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(d + 16 * k));
+			if (p.additive)
+				v = _mm_adds_epu8(v, _mm_load_si128(reinterpret_cast<__m128i const*>(offset + 16 * k)));
+			else
+			{
+				auto const f = reinterpret_cast<__m128i const*>(factor + 16 * k);
+				auto const a = reinterpret_cast<__m128i const*>(addend + 16 * k);
+				__m128i const lo = _mm_unpacklo_epi8(v, zero);
+				__m128i const hi = _mm_unpackhi_epi8(v, zero);
+				__m128i const scaledLo = _mm_mullo_epi16(lo, _mm_load_si128(f));
+				__m128i const scaledHi = _mm_mullo_epi16(hi, _mm_load_si128(f + 1));
+				__m128i const blendedLo = _mm_add_epi16(scaledLo, _mm_load_si128(a));
+				__m128i const blendedHi = _mm_add_epi16(scaledHi, _mm_load_si128(a + 1));
+				v = _mm_packus_epi16(div255(blendedLo), div255(blendedHi));
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(d + 16 * k), v);
+		}
+	}
+	return i;
+}
+
+/// Blends 16-bit lanes of source color @p s with alpha @p a onto destination @p d.
+inline __m128i blend_lanes(__m128i d, __m128i s, __m128i a, blend_mode mode)
+{
+	__m128i const full = _mm_set1_epi16(255);
+	switch (mode)
+	{
+		case blend_mode::source_over:
+			return div255(_mm_add_epi16(_mm_mullo_epi16(s, a), _mm_mullo_epi16(d, _mm_sub_epi16(full, a))));
+		case blend_mode::additive:
+			return _mm_add_epi16(d, div255(_mm_mullo_epi16(s, a)));  // saturated by the final pack
+		case blend_mode::multiply:
+		default:
+		{
+			// multiply with the source color composited over white first, so that alpha fades it out
+			__m128i const white = _mm_mullo_epi16(full, _mm_sub_epi16(full, a));
+			__m128i const tint = div255(_mm_add_epi16(_mm_mullo_epi16(s, a), white));
+			return div255(_mm_mullo_epi16(d, tint));
+		}
+	}
+}
+
+inline __m128i load12(byte const* p)
+{
+	int32_t tail;
+	memcpy(&tail, p + 8, sizeof(tail));
+	return _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(p)), _mm_cvtsi32_si128(tail));
+}
+
+inline void store12(byte* p, __m128i v)
+{
+	_mm_storel_epi64(reinterpret_cast<__m128i*>(p), v);
+	int32_t const tail = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+	memcpy(p + 8, &tail, sizeof(tail));
+}
+
+/// Blends 4 pixels per iteration, deinterleaving RGBA into RGB and per-channel alpha with pshufb.
+__attribute__((target("ssse3"))) size_t draw_row_ssse3(byte* d, color::rgba_color const* s, size_t count,
+													   blend_mode mode)
+{
+	__m128i const colorMask = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+	__m128i const alphaMask = _mm_setr_epi8(3, 3, 3, 7, 7, 7, 11, 11, 11, 15, 15, 15, -1, -1, -1, -1);
+	__m128i const zero = _mm_setzero_si128();
+
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4, d += 12)
+	{
+		__m128i const sv = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s + i));
+		__m128i const sc = _mm_shuffle_epi8(sv, colorMask);
+		__m128i const sa = _mm_shuffle_epi8(sv, alphaMask);
+		__m128i const dv = load12(d);
+
+		__m128i const lo = blend_lanes(_mm_unpacklo_epi8(dv, zero), _mm_unpacklo_epi8(sc, zero),
+									   _mm_unpacklo_epi8(sa, zero), mode);
+		__m128i const hi = blend_lanes(_mm_unpackhi_epi8(dv, zero), _mm_unpackhi_epi8(sc, zero),
+									   _mm_unpackhi_epi8(sa, zero), mode);
+		store12(d, _mm_packus_epi16(lo, hi));
+	}
+	return i;
+}
+// }}}
+
+// {{{ AVX2 kernels
+__attribute__((target("avx2"))) inline __m256i div255(__m256i x)
+{
+	x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+	return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+/// Fills 32 pixels (96 bytes) per iteration, using the channel pattern that repeats every 96 bytes.
+__attribute__((target("avx2"))) size_t fill_row_avx2(byte* d, size_t count, fill_params const& p)
+{
+	// 16-bit patterns in the in-lane order of unpack{lo,hi}: lo = bytes 0-7, 16-23; hi = bytes 8-15, 24-31
+	alignas(32) uint16_t factor[3][2][16];
+	alignas(32) uint16_t addend[3][2][16];
+	alignas(32) uint8_t offset[96];
+	for (int k = 0; k < 3; ++k)
+		for (int half = 0; half < 2; ++half)
+			for (int j = 0; j < 16; ++j)
+			{
+				int const byteIndex = 32 * k + (j < 8 ? j : j + 8) + 8 * half;
+				factor[k][half][j] = p.factor[byteIndex % 3];
+				addend[k][half][j] = p.addend[byteIndex % 3];
+			}
+	for (int i = 0; i < 96; ++i)
+		offset[i] = p.offset[i % 3];
+
+	__m256i const zero = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 32 <= count; i += 32, d += 96)
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			__m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(d + 32 * k));
+			if (p.additive)
+				v = _mm256_adds_epu8(v, _mm256_load_si256(reinterpret_cast<__m256i const*>(offset + 32 * k)));
+			else
+			{
+				auto const f = reinterpret_cast<__m256i const*>(factor[k]);
+				auto const a = reinterpret_cast<__m256i const*>(addend[k]);
+				__m256i const lo = _mm256_unpacklo_epi8(v, zero);
+				__m256i const hi = _mm256_unpackhi_epi8(v, zero);
+				__m256i const scaledLo = _mm256_mullo_epi16(lo, _mm256_load_si256(f));
+				__m256i const scaledHi = _mm256_mullo_epi16(hi, _mm256_load_si256(f + 1));
+				__m256i const blendedLo = _mm256_add_epi16(scaledLo, _mm256_load_si256(a));
+				__m256i const blendedHi = _mm256_add_epi16(scaledHi, _mm256_load_si256(a + 1));
+				v = _mm256_packus_epi16(div255(blendedLo), div255(blendedHi));
+			}
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(d + 32 * k), v);
+		}
+	}
+	return i + fill_row_sse2(d, count - i, p);
+}
+
+__attribute__((target("avx2"))) inline __m256i blend_lanes(__m256i d, __m256i s, __m256i a, blend_mode mode)
+{
+	__m256i const full = _mm256_set1_epi16(255);
+	switch (mode)
+	{
+		case blend_mode::source_over:
+			return div255(
+				_mm256_add_epi16(_mm256_mullo_epi16(s, a), _mm256_mullo_epi16(d, _mm256_sub_epi16(full, a))));
+		case blend_mode::additive:
+			return _mm256_add_epi16(d, div255(_mm256_mullo_epi16(s, a)));  // saturated by the final pack
+		case blend_mode::multiply:
+		default:
+		{
+			__m256i const white = _mm256_mullo_epi16(full, _mm256_sub_epi16(full, a));
+			__m256i const tint = div255(_mm256_add_epi16(_mm256_mullo_epi16(s, a), white));
+			return div255(_mm256_mullo_epi16(d, tint));
+		}
+	}
+}
+
+/// Blends 8 pixels per iteration, 4 in each 128-bit lane.
+__attribute__((target("avx2"))) size_t draw_row_avx2(byte* d, color::rgba_color const* s, size_t count,
+													 blend_mode mode)
+{
+	__m256i const colorMask = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+											   0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+	__m256i const alphaMask = _mm256_setr_epi8(3, 3, 3, 7, 7, 7, 11, 11, 11, 15, 15, 15, -1, -1, -1, -1,
+											   3, 3, 3, 7, 7, 7, 11, 11, 11, 15, 15, 15, -1, -1, -1, -1);
+	__m256i const zero = _mm256_setzero_si256();
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8, d += 24)
+	{
+		__m256i const sv = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(s + i));
+		__m256i const sc = _mm256_shuffle_epi8(sv, colorMask);
+		__m256i const sa = _mm256_shuffle_epi8(sv, alphaMask);
+		__m256i const dv = _mm256_inserti128_si256(_mm256_castsi128_si256(load12(d)), load12(d + 12), 1);
+
+		__m256i const lo = blend_lanes(_mm256_unpacklo_epi8(dv, zero), _mm256_unpacklo_epi8(sc, zero),
+									   _mm256_unpacklo_epi8(sa, zero), mode);
+		__m256i const hi = blend_lanes(_mm256_unpackhi_epi8(dv, zero), _mm256_unpackhi_epi8(sc, zero),
+									   _mm256_unpackhi_epi8(sa, zero), mode);
+		__m256i const out = _mm256_packus_epi16(lo, hi);
+
+		store12(d, _mm256_castsi256_si128(out));
+		store12(d + 12, _mm256_extracti128_si256(out, 1));
+	}
+	return i + draw_row_ssse3(d, s + i, count - i, mode);
+}
+// }}}
+#endif
+
+simd_level supported_level() noexcept
+{
+#if defined(SGFX_BLEND_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return simd_level::avx2;
+	if (__builtin_cpu_supports("ssse3"))
+		return simd_level::ssse3;
+	return simd_level::sse2;
+#else
+	return simd_level::scalar;
+#endif
+}
+
+atomic<simd_level>& current_level() noexcept
+{
+	static atomic<simd_level> level{supported_level()};
+	return level;
+}
+
+void fill_row(byte* d, size_t count, fill_params const& p)
+{
+	size_t done = 0;
+#if defined(SGFX_BLEND_X86)
+	switch (current_level().load(memory_order_relaxed))
+	{
+		case simd_level::avx2:
+			done = fill_row_avx2(d, count, p);
+			break;
+		case simd_level::ssse3:
+		case simd_level::sse2:
+			done = fill_row_sse2(d, count, p);
+			break;
+		case simd_level::scalar:
+			break;
+	}
+#endif
+	fill_row_scalar(d + 3 * done, count - done, p);
+}
+
+void draw_row(byte* d, color::rgba_color const* s, size_t count, blend_mode mode)
+{
+	size_t done = 0;
+#if defined(SGFX_BLEND_X86)
+	switch (current_level().load(memory_order_relaxed))
+	{
+		case simd_level::avx2:
+			done = draw_row_avx2(d, s, count, mode);
+			break;
+		case simd_level::ssse3:
+			done = draw_row_ssse3(d, s, count, mode);
+			break;
+		case simd_level::sse2:  // no byte shuffles to deinterleave RGBA without SSSE3
+		case simd_level::scalar:
+			break;
+	}
+#endif
+	draw_row_scalar(d + 3 * done, s + done, count - done, mode);
+}
+
+}  // namespace
+
+simd_level blend_simd_level() noexcept
+{
+	return current_level().load();
+}
+
+simd_level set_blend_simd_level(simd_level level) noexcept
+{
+	level = min(level, supported_level());
+	current_level().store(level);
+	return level;
+}
+
+void fill(widget& target, rectangle rect, color::rgba_color col, blend_mode mode)
+{
+	auto const area = intersection(rect, rectangle{{0, 0}, target.size()});
+	if (area.empty())
+		return;
+
+	auto const params = make_fill_params(col, mode);
+	auto const stride = target.width();
+	auto row = target.pixels().data() + area.top() * stride + area.left();
+
+	for (int y = area.top(); y < area.bottom(); ++y, row += stride)
+		fill_row(reinterpret_cast<byte*>(row), area.size.width, params);
+
+	target.damage(area);
+}
+
+void draw(widget& target, rgba_image const& source, point top_left, blend_mode mode)
+{
+	auto const area = intersection(rectangle{top_left, source.size()}, rectangle{{0, 0}, target.size()});
+	if (area.empty())
+		return;
+
+	auto const sourceStride = source.width();
+	auto const targetStride = target.width();
+	auto src = source.pixels().data() + (area.top() - top_left.y) * sourceStride + (area.left() - top_left.x);
+	auto dst = target.pixels().data() + area.top() * targetStride + area.left();
+
+	for (int y = 0; y < area.size.height; ++y, src += sourceStride, dst += targetStride)
+		draw_row(reinterpret_cast<byte*>(dst), src, area.size.width, mode);
+
+	target.damage(area);
+}
+
+}  // namespace sgfx
@@ -9,6 +9,8 @@
 #include <sgfx/canvas.hpp>
 #include <sgfx/primitives.hpp>
 
+#include <algorithm>
+
 namespace sgfx {
 
 canvas canvas::colored(dimension size, color::rgb_color col)
@@ -20,14 +22,25 @@ canvas canvas::colored(dimension size, color::rgb_color col)
 
 void draw(widget& target, const canvas& source, point top_left)
 {
-	auto const static inRange = [](auto x, auto begin, auto end) { return begin <= x && x < end; };
+	draw(target, source, top_left, {{0, 0}, target.size()});
+}
+
+void draw(widget& target, const canvas& source, point top_left, rectangle clip)
+{
+	auto const area = intersection(intersection(rectangle{top_left, source.size()}, clip),
+								   rectangle{{0, 0}, target.size()});
+	if (area.empty())
+		return;
+
+	auto const sourceStride = source.width();
+	auto const targetStride = target.width();
+	auto src = source.pixels().data() + (area.top() - top_left.y) * sourceStride + (area.left() - top_left.x);
+	auto dst = target.pixels().data() + area.top() * targetStride + area.left();
 
-	for (int x = 0; x < source.width(); ++x)
-		for (int y = 0; y < source.height(); ++y)
-			if (inRange(top_left.x + x, 0, target.width()) && inRange(top_left.y + y, 0, target.height()))
-				target[top_left + point{x, y}] = source[point{x, y}];
+	for (int y = 0; y < area.size.height; ++y, src += sourceStride, dst += targetStride)
+		std::copy_n(src, area.size.width, dst);
 
-	// TODO: super naive implementation wants to be replaced with its superior
+	target.damage(area);
 }
 
 }  // namespace sgfx
@@ -0,0 +1,40 @@
+#include <sgfx/canvas_pool.hpp>
+#include <sgfx/primitives.hpp>
+
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+namespace sgfx {
+
+canvas& canvas_pool::acquire(dimension size)
+{
+	auto const free = begin(slots_) + used_;
+	auto slot = find_if(free, end(slots_), [&](canvas const& c) { return c.size() == size; });
+
+	if (slot == end(slots_))
+	{
+		// no free canvas of that size, so repurpose a free one of another size, or grow the pool
+		if (free != end(slots_))
+		{
+			slot = free;
+			*slot = canvas{size};
+		}
+		else
+			slot = slots_.emplace(end(slots_), size);
+	}
+
+	// keep handed out canvases in front; references to them stay valid, as only free ones are moved
+	swap(*slot, slots_[used_]);
+	return slots_[used_++];
+}
+
+canvas& canvas_pool::acquire(dimension size, color::rgb_color col)
+{
+	auto& result = acquire(size);
+	clear(result, col);
+	return result;
+}
+
+}  // namespace sgfx
@@ -0,0 +1,92 @@
+#include <sgfx/display_list.hpp>
+#include <sgfx/primitives.hpp>
+
+#include <algorithm>
+
+using namespace std;
+
+namespace sgfx {
+
+namespace {
+
+template <typename... Ts>
+struct overloaded : Ts... {
+	using Ts::operator()...;
+};
+
+template <typename... Ts>
+overloaded(Ts...)->overloaded<Ts...>;
+
+/// Mirrors the clamping semantics of plot().
+point clamped(point p, widget const& target)
+{
+	return point{min(p.x, target.width() - 1), min(p.y, target.height() - 1)};
+}
+
+}  // namespace
+
+rectangle display_list::bounds(command const& cmd, widget const& target)
+{
+	auto const rect = visit(
+		overloaded{
+			[&](plot_cmd const& c) { return rectangle{clamped(c.p, target), {1, 1}}; },
+			[&](clear_cmd const&) { return rectangle{{0, 0}, target.size()}; },
+			[](fill_cmd const& c) { return c.rect; },
+			[&](line_cmd const& c) { return bounding_box(c.p0, c.p1, {{0, 0}, target.size()}); },
+			[](canvas_cmd const& c) { return rectangle{c.top_left, c.image->size()}; },
+			[](rle_cmd const& c) { return rectangle{c.top_left, c.image->dim()}; },
+		},
+		cmd);
+
+	return intersection(rect, rectangle{{0, 0}, target.size()});
+}
+
+void display_list::rasterize(command const& cmd, widget& target, rectangle const& tile)
+{
+	visit(overloaded{
+			  [&](plot_cmd const& c) { sgfx::fill(target, {clamped(c.p, target), {1, 1}}, c.color, tile); },
+			  [&](clear_cmd const& c) { sgfx::fill(target, {{0, 0}, target.size()}, c.color, tile); },
+			  [&](fill_cmd const& c) { sgfx::fill(target, c.rect, c.color, tile); },
+			  [&](line_cmd const& c) { sgfx::line(target, c.p0, c.p1, c.color, tile); },
+			  [&](canvas_cmd const& c) { sgfx::draw(target, *c.image, c.top_left, tile); },
+			  [&](rle_cmd const& c) {
+				  if (c.keyed)
+					  sgfx::draw(target, *c.image, c.top_left, c.colorkey, tile);
+				  else
+					  sgfx::draw(target, *c.image, c.top_left, tile);
+			  },
+		  },
+		  cmd);
+}
+
+void display_list::submit(widget& target, thread_pool& pool)
+{
+	auto const columns = (target.width() + tile_size_ - 1) / tile_size_;
+	auto const rows = (target.height() + tile_size_ - 1) / tile_size_;
+
+	bins_.resize(static_cast<size_t>(columns * rows));
+	for (auto& bin : bins_)
+		bin.clear();
+
+	// bin commands into every tile their bounding box touches, preserving recording order
+	for (size_t i = 0; i < commands_.size(); ++i)
+	{
+		auto const area = bounds(commands_[i], target);
+		if (area.empty())
+			continue;
+
+		for (int ty = area.top() / tile_size_; ty <= (area.bottom() - 1) / tile_size_; ++ty)
+			for (int tx = area.left() / tile_size_; tx <= (area.right() - 1) / tile_size_; ++tx)
+				bins_[ty * columns + tx].push_back(static_cast<uint32_t>(i));
+	}
+
+	pool.parallel_for(bins_.size(), [&](size_t t) {
+		auto const column = static_cast<int>(t % columns);
+		auto const row = static_cast<int>(t / columns);
+		auto const tile = rectangle{{column * tile_size_, row * tile_size_}, {tile_size_, tile_size_}};
+		for (auto const i : bins_[t])
+			rasterize(commands_[i], target, tile);
+	});
+}
+
+}  // namespace sgfx
@@ -0,0 +1,36 @@
+#include "file.hpp"
+
+#include <experimental/filesystem>
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace sgfx::detail {
+
+string readFile(string const& _path)
+{
+	auto const path = experimental::filesystem::path{_path};
+	auto const fileSize = experimental::filesystem::file_size(path);
+
+	auto data = string{};
+	data.resize(fileSize);
+
+	auto ifs = ifstream{path, ios::binary};
+	if (!ifs.is_open())
+		throw runtime_error("Could not open file.");
+
+	ifs.read(data.data(), static_cast<streamsize>(fileSize));
+	if (static_cast<size_t>(ifs.tellg()) < static_cast<size_t>(fileSize))
+	{
+		auto msg = ostringstream{};
+		msg << "Expected to read " << fileSize << " bytes but only read " << ifs.tellg() << " bytes.";
+		throw runtime_error{msg.str()};
+	}
+
+	return data;
+}
+
+}  // namespace sgfx::detail
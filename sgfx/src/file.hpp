@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+
+namespace sgfx::detail {
+
+/**
+ * Reads the whole file at @p path with a single read.
+ *
+ * @throws std::runtime_error or std::experimental::filesystem::filesystem_error if it cannot be read.
+ */
+std::string readFile(std::string const& path);
+
+}  // namespace sgfx::detail
@@ -0,0 +1,122 @@
+#include <sgfx/frame_stats.hpp>
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+namespace sgfx {
+
+namespace {
+
+using milliseconds = chrono::duration<double, milli>;
+
+frame_timing::duration phase_of(frame_timing const& timing, frame_phase phase) noexcept
+{
+	switch (phase)
+	{
+		case frame_phase::render:
+			return timing.render;
+		case frame_phase::upload:
+			return timing.upload;
+		case frame_phase::swap:
+			return timing.swap;
+		case frame_phase::wait:
+			return timing.wait;
+		case frame_phase::total:
+		default:
+			return timing.total();
+	}
+}
+
+}  // namespace
+
+frame_stats::frame_stats(size_t window) : samples_(window)
+{
+	if (window == 0)
+		throw invalid_argument("Frame statistics need a window of at least one frame.");
+}
+
+void frame_stats::record(frame_timing const& timing)
+{
+	samples_[total_frames_ % samples_.size()] = timing;
+	++total_frames_;
+}
+
+void frame_stats::reset() noexcept
+{
+	total_frames_ = 0;
+}
+
+frame_timing frame_stats::last() const noexcept
+{
+	return total_frames_ ? samples_[(total_frames_ - 1) % samples_.size()] : frame_timing{};
+}
+
+frame_stats::duration frame_stats::percentile(frame_phase phase, double fraction) const
+{
+	auto const count = frames();
+	if (count == 0)
+		return duration::zero();
+
+	vector<duration> values(count);
+	for (size_t i = 0; i < count; ++i)
+		values[i] = phase_of(samples_[i], phase);
+
+	auto const rank = min(count - 1, static_cast<size_t>(clamp(fraction, 0.0, 1.0) * (count - 1) + 0.5));
+	nth_element(begin(values), begin(values) + rank, end(values));
+	return values[rank];
+}
+
+void frame_stats::dump(ostream& out) const
+{
+	struct phase_name {
+		frame_phase phase;
+		char const* name;
+	};
+	static phase_name const phases[] = {{frame_phase::render, "render"}, {frame_phase::upload, "upload"},
+										{frame_phase::swap, "swap"},     {frame_phase::wait, "wait"},
+										{frame_phase::total, "total"}};
+
+	auto const flags = out.flags();
+	auto const precision = out.precision();
+	out << fixed << setprecision(3);
+
+	out << "frame times over the last " << frames() << " of " << total_frames_ << " frames (ms):\n";
+	out << "  phase        p50        p99        max\n";
+	for (auto const& [phase, name] : phases)
+		out << "  " << left << setw(6) << name << right << setw(11)
+			<< milliseconds{percentile(phase, 0.5)}.count() << setw(11)
+			<< milliseconds{percentile(phase, 0.99)}.count() << setw(11)
+			<< milliseconds{percentile(phase, 1.0)}.count() << '\n';
+
+	// frame time histogram, bucketed along common refresh rates
+	static double const bounds[] = {1000.0 / 240, 1000.0 / 144, 1000.0 / 120, 1000.0 / 60, 1000.0 / 30,
+									1000.0 / 15};
+	constexpr size_t bucketCount = size(bounds) + 1;
+	size_t counts[bucketCount] = {};
+	for (size_t i = 0; i < frames(); ++i)
+	{
+		auto const ms = milliseconds{samples_[i].total()}.count();
+		++counts[upper_bound(begin(bounds), end(bounds), ms) - begin(bounds)];
+	}
+
+	auto const peak = max(size_t{1}, *max_element(begin(counts), end(counts)));
+	out << "  total frame time histogram:\n" << setprecision(1);
+	for (size_t i = 0; i < bucketCount; ++i)
+	{
+		auto const bound = bounds[min(i, size(bounds) - 1)];
+		out << "  " << (i < size(bounds) ? "< " : ">=") << setw(6) << bound << " ms " << setw(7) << counts[i];
+		if (counts[i])
+			out << ' ' << string(max(size_t{1}, counts[i] * 40 / peak), '#');
+		out << '\n';
+	}
+
+	out.flags(flags);
+	out.precision(precision);
+}
+
+}  // namespace sgfx
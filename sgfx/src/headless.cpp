@@ -0,0 +1,132 @@
+#include <sgfx/headless.hpp>
+#include <sgfx/image.hpp>
+#include <sgfx/trace.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace sgfx {
+
+namespace {
+
+key_id parse_key(string const& name)
+{
+	if (name.size() == 1)
+		return key_id{name[0]};
+
+	static const struct {
+		char const* name;
+		key_id key;
+	} names[] = {
+		{"space", key::space}, {"escape", key::escape}, {"left", key::left},           {"right", key::right},
+		{"up", key::up},       {"down", key::down},     {"backspace", key::backspace},
+	};
+
+	for (auto const& n : names)
+		if (name == n.name)
+			return n.key;
+
+	throw runtime_error{"Unknown key name in input script: " + name};
+}
+
+}  // namespace
+
+bool headless::handle_events()
+{
+	for (; next_event_ < script_.size() && script_[next_event_].frame <= frame_; ++next_event_)
+	{
+		auto const& event = script_[next_event_];
+		auto const i = find(begin(pressed_), end(pressed_), event.key);
+
+		if (event.pressed && i == end(pressed_))
+			pressed_.push_back(event.key);
+		else if (!event.pressed && i != end(pressed_))
+			pressed_.erase(i);
+	}
+	return true;
+}
+
+bool headless::is_pressed(key_id key) const
+{
+	return find(begin(pressed_), end(pressed_), key) != end(pressed_);
+}
+
+void headless::show()
+{
+	trace_span const span{"show", "frame"};
+
+	if (!dump_pattern_.empty())
+	{
+		char path[4096];
+		snprintf(path, sizeof(path), dump_pattern_.c_str(), frame_);
+		save_ppm(*this, path);
+	}
+
+	++frame_;
+}
+
+void headless::set_frame_dump(string pattern)
+{
+	// the pattern becomes the format of snprintf(), so it must not ask for anything but the frame number
+	auto conversions = 0;
+	for (auto i = pattern.find('%'); i != string::npos; i = pattern.find('%', i + 1))
+	{
+		if (i + 1 < pattern.size() && pattern[i + 1] == '%')
+		{
+			++i;
+			continue;
+		}
+
+		i = pattern.find_first_not_of("0123456789", i + 1);
+		if (i == string::npos || (pattern[i] != 'u' && pattern[i] != 'd'))
+		{
+			conversions = -1;
+			break;
+		}
+		++conversions;
+	}
+
+	if (conversions != 1)
+		throw runtime_error{"The frame dump pattern must contain exactly one %u or %d: " + pattern};
+
+	dump_pattern_ = move(pattern);
+}
+
+void headless::script(unsigned frame, key_id key, bool pressed)
+{
+	auto const i = upper_bound(begin(script_), end(script_), frame,
+							   [](unsigned f, input_event const& e) { return f < e.frame; });
+	auto const index = static_cast<size_t>(i - begin(script_));
+	script_.insert(i, input_event{frame, key, pressed});
+
+	if (index < next_event_)
+		++next_event_;  // scheduled in the past, nothing to replay anymore
+}
+
+void headless::load_script(string const& path)
+{
+	ifstream in{path};
+	if (!in.is_open())
+		throw runtime_error{"Could not open input script: " + path};
+
+	string line;
+	for (unsigned lineNo = 1; getline(in, line); ++lineNo)
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		unsigned frame = 0;
+		string action, key;
+		if (!(istringstream{line} >> frame >> action >> key) || (action != "press" && action != "release"))
+			throw runtime_error{path + ":" + std::to_string(lineNo) + ": Invalid input script line."};
+
+		script(frame, parse_key(key), action == "press");
+	}
+}
+
+}  // namespace sgfx
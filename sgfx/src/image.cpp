@@ -4,39 +4,110 @@
 #include <sgfx/primitive_types.hpp>
 #include <sgfx/primitives.hpp>
 
-//#include "sysconfig.h"
+#include "file.hpp"
 
-#include <experimental/filesystem>
+//#include "sysconfig.h"
 
 #include <algorithm>
 #include <fstream>
 #include <map>
-#include <sstream>
 #include <stdexcept>
 #include <string>
 #include <utility>
 
 #include <cassert>
+#include <cstring>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#    include <emmintrin.h>
+#endif
 
 using namespace std;
-using namespace std::experimental;
 
 #define let auto /* Pure provocation with respect to my dire love to F# & my hate to C++ auto keyword. */
 
 namespace {
 
-template <typename T>
-T read(std::istream& source)
+/**
+ * Splits the @p count pixels at @p pixels, 3 bytes each, into runs of equal color of up to 255 pixels.
+ *
+ * @p emit(first, length) is invoked for each run in order, @p first pointing to the run's first pixel.
+ */
+template <typename Emit>
+void scanRuns(uint8_t const* pixels, size_t count, Emit emit)
 {
-    T value;
-    source.read((char*) &value, sizeof(value));
-    return value;
+    size_t start = 0;
+    let const endRun = [&](size_t end) {
+        for (; end - start > 255; start += 255)
+            emit(pixels + 3 * start, 255);
+        emit(pixels + 3 * start, end - start);
+        start = end;
+    };
+
+    // index of the next pixel to compare with its successor
+    size_t i = 0;
+
+#if defined(__SSE2__) && defined(__GNUC__)
+    // Pixel i + 1 continues the run iff its bytes equal the ones 3 positions earlier. Comparing 48 bytes
+    // at once yields a bit per byte, so the pixel boundaries of 16 pixels are where any of the 3 bits
+    // starting at a multiple of 3 is clear. Only those boundaries need to be visited then.
+    for (; i + 17 <= count; i += 16)
+    {
+        let const bytes = pixels + 3 * i;
+        let equal = uint64_t{0};
+        for (int k = 0; k < 3; ++k)
+        {
+            let const previous = _mm_loadu_si128(reinterpret_cast<__m128i const*>(bytes + 16 * k));
+            let const next = _mm_loadu_si128(reinterpret_cast<__m128i const*>(bytes + 16 * k + 3));
+            let const mask = static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(previous, next)));
+            equal |= uint64_t{mask} << (16 * k);
+        }
+
+        for (let boundaries = ~(equal & (equal >> 1) & (equal >> 2)) & 0x249249249249u; boundaries != 0;
+             boundaries &= boundaries - 1)
+            endRun(i + static_cast<size_t>(__builtin_ctzll(boundaries)) / 3 + 1);
+    }
+#endif
+
+    for (; i + 1 < count; ++i)
+        if (memcmp(pixels + 3 * i, pixels + 3 * i + 3, 3) != 0)
+            endRun(i + 1);
+
+    if (count != 0)
+        endRun(count);
 }
 
-template <typename T>
-void write(std::ostream& os, T const& value)
+/// Blits the runs of @p source that lie within @p clip and for which @p opaque(color) holds.
+template <typename Opaque>
+void drawRuns(sgfx::widget& target, sgfx::rle_image const& source, sgfx::point top_left,
+              sgfx::rectangle clip, Opaque opaque)
 {
-    os.write((char*) &value, sizeof(value));
+    using namespace sgfx;
+
+    let const area = intersection(intersection(rectangle{top_left, source.dim()}, clip),
+                                  rectangle{{0, 0}, target.size()});
+    if (area.empty())
+        return;
+
+    let const bottom = min(area.bottom(), top_left.y + static_cast<int>(source.row_count()));
+    let const stride = target.width();
+
+    for (int y = area.top(); y < bottom; ++y)
+    {
+        let const row = target.pixels().data() + y * stride;
+        let x = top_left.x;
+        for (rle_image::Run const& run : source.row(y - top_left.y))
+        {
+            let const from = max(x, area.left());
+            let const to = min(x + run.length, area.right());
+            if (from < to && opaque(run.color))
+                fill_n(row + from, to - from, run.color);
+            if ((x += run.length) >= area.right())
+                break;
+        }
+    }
+
+    target.damage(area);
 }
 
 }  // namespace
@@ -44,179 +115,171 @@ void write(std::ostream& os, T const& value)
 namespace sgfx {
 
 
-canvas load_ppm(const std::string& _path)
+canvas load_ppm(const std::string& path)
 {
-    experimental::filesystem::path path{_path};
-    let fileSize = experimental::filesystem::file_size(path);
-
-    let data = string{};
-    data.resize(fileSize);
+    return ppm::Parser{}.parseString(detail::readFile(path));
+}
 
-    ifstream ifs{path, ios::binary};
-    if (!ifs.is_open())
+void save_ppm(widget const& image, const std::string& filename, ppm::Format format)
+{
+    let os = ofstream{filename, ios::binary};
+    if (!os.is_open())
         throw runtime_error("Could not open file.");
 
-    ifs.read(data.data(), fileSize);
-    if (static_cast<size_t>(ifs.tellg()) < static_cast<size_t>(fileSize))
-	{
-        auto msg = ostringstream{};
-		msg << "Expected to read " << fileSize << " bytes but only read " << ifs.tellg() << " bytes.";
-        throw runtime_error{msg.str()};
-	}
+    let const channels = reinterpret_cast<uint8_t const*>(image.pixels().data());
+    ppm::Writer{format}.write(image.size(), channels, [&](char const* data, size_t size) {
+        os.write(data, static_cast<streamsize>(size));
+    });
 
-    return ppm::Parser{}.parseString(data);
+    if (!os)
+        throw runtime_error("Could not write file.");
 }
 
-void save_ppm(widget const& image, const std::string& filename)
+void rle_image::encodeLine(uint8_t const* pixels, size_t count, std::vector<uint8_t>& output)
 {
-    let os = ofstream{filename};
-
-    os << "P3\n"
-       << "# Created by Gods of Code\n"
-       << image.width() << ' ' << image.height() << '\n'
-       << "255\n";
-
-    let const pixelWriter = [&](let pixel) {
-        os << pixel.red() << ' ' << pixel.green() << ' ' << pixel.blue() << '\n';
-    };
-
-    for_each(cbegin(image.pixels()), cend(image.pixels()), pixelWriter);
+    // the number of runs precedes them, so it is patched in once they are known
+    let const start = output.size();
+    output.resize(start + 2);
+
+    let runs = 0u;
+    scanRuns(pixels, count, [&](uint8_t const* color, size_t length) {
+        output.push_back(static_cast<uint8_t>(length));
+        output.insert(output.end(), color, color + 3);
+        ++runs;
+    });
+
+    output[start] = static_cast<uint8_t>(runs & 0xFF);
+    output[start + 1] = static_cast<uint8_t>((runs >> 8) & 0xFF);
 }
 
 void rle_image::encodeLine(std::vector<uint8_t> const& input, std::vector<uint8_t>& output)
 {
-    size_t i = 0;
-    while (i + 2 < input.size())
-    {
-        auto const red = input[i++];
-        auto const green = input[i++];
-        auto const blue = input[i++];
-
-        auto count = uint8_t{1};
-        while (i + 2 < input.size() && count < 255 && input[i] == red && input[i + 1] == green
-               && input[i + 2] == blue)
-        {
-			i += 3;
-            ++count;
-        }
-
-        output.push_back(count);
-        output.push_back(red);
-        output.push_back(green);
-        output.push_back(blue);
-    }
-    assert(i == input.size());
+    assert(input.size() % 3 == 0);
+    encodeLine(input.data(), input.size() / 3, output);
 }
 
-std::vector<rle_image::Run> rle_image::decodeLine(uint8_t const* line, size_t width)
+rle_image::Row rle_image::decodeLine(uint8_t const*& line, uint8_t const* end)
 {
-    let runs = vector<Run>(line[0] | (line[1] << 8));
+    if (end - line < 2)
+        throw runtime_error{"Unexpected end of RLE data."};
+
+    let runs = Row(line[0] | (line[1] << 8));
     line += 2;
 
-    for (unsigned i = 0; i < runs.size(); ++i)
+    if (static_cast<size_t>(end - line) < 4 * runs.size())
+        throw runtime_error{"Unexpected end of RLE data."};
+
+    for (let& run : runs)
     {
-        let const length = *line++;
-        let const red = *line++;
-        let const green = *line++;
-        let const blue = *line++;
-        runs[i] = Run{length, color::rgb_color{red, green, blue}};
+        run = Run{line[0], color::rgb_color{line[1], line[2], line[3]}};
+        line += 4;
     }
 
     return runs;
 }
 
-rle_image load_rle(const std::string& filename)
+rle_image rle_image::load(std::string const& data)
 {
-    let in = ifstream{filename, ios::binary};
-    if (!in.is_open())
-        throw std::runtime_error{"Could not open file."};
+    let line = reinterpret_cast<uint8_t const*>(data.data());
+    let const end = line + data.size();
+    if (data.size() < 4)
+        throw runtime_error{"Unexpected end of RLE data."};
 
-    let const width = read<uint16_t>(in);
-    let const height = read<uint16_t>(in);
+    let const width = line[0] | (line[1] << 8);
+    let const height = line[2] | (line[3] << 8);
+    line += 4;
 
-    let lines = vector<vector<rle_image::Run>>();
-    while (in.good())
-    {
-        let runs = vector<rle_image::Run>(read<uint16_t>(in));
+    let rows = vector<Row>(height);
+    for (let& row : rows)
+        row = decodeLine(line, end);
 
-        for (unsigned i = 0; i < runs.size(); ++i)
-        {
-            let const length = read<uint8_t>(in);
-            let const red = read<uint8_t>(in);
-            let const green = read<uint8_t>(in);
-            let const blue = read<uint8_t>(in);
-            runs[i] = rle_image::Run{length, color::rgb_color{red, green, blue}};
-        }
-        lines.emplace_back(move(runs));
-        // TODO: lines.emplace_back(rle_image::decodeLine(line, width));
-    }
+    if (line != end)
+        throw runtime_error{"Unexpected data after the last row."};
+
+    return rle_image{dimension{width, height}, move(rows)};
+}
 
-    return rle_image{dimension{width, height}, move(lines)};
+rle_image load_rle(const std::string& filename)
+{
+    return rle_image::load(detail::readFile(filename));
 }
 
 void save_rle(const rle_image& image, const std::string& filename)
 {
-    ofstream os{filename, ios::binary};
+    let size = size_t{4};
+    for (rle_image::Row const& row : image.rows())
+        size += 2 + 4 * row.size();
+
+    let data = vector<uint8_t>();
+    data.reserve(size);
+    let const put16 = [&](unsigned value) {
+        data.push_back(static_cast<uint8_t>(value & 0xFF));
+        data.push_back(static_cast<uint8_t>((value >> 8) & 0xFF));
+    };
 
-    write<uint16_t>(os, image.dim().width);
-    write<uint16_t>(os, image.dim().height);
+    put16(image.dim().width);
+    put16(image.dim().height);
 
     for (rle_image::Row const& row : image.rows())
     {
-        write<uint16_t>(os, static_cast<uint16_t>(row.size()));
+        put16(static_cast<unsigned>(row.size()));
         for (rle_image::Run const& run : row)
         {
-            write<uint8_t>(os, run.length);
-            write<uint8_t>(os, run.color.red());
-            write<uint8_t>(os, run.color.green());
-            write<uint8_t>(os, run.color.blue());
+            data.push_back(run.length);
+            data.push_back(run.color.red());
+            data.push_back(run.color.green());
+            data.push_back(run.color.blue());
         }
     }
+
+    ofstream os{filename, ios::binary};
+    if (!os.is_open())
+        throw runtime_error{"Could not open file."};
+
+    os.write(reinterpret_cast<char const*>(data.data()), static_cast<streamsize>(data.size()));
+    if (!os)
+        throw runtime_error{"Could not write file."};
 }
 
 rle_image rle_encode(widget& image)
 {
-    using Run = rle_image::Run;
-
-    // reads one run, i.e. one color and all up to 255 following colors that match that first color.
-    auto readOne = [&image](int x, int y) -> Run {
-        let const color = image[point{x, y}];
-        let length = uint8_t{1};
-        ++x;
-        while (x < image.width() && length < 255 && image[point{x, y}] == color)
-            ++length, ++x;
-        return {length, color};
-    };
+    let const width = static_cast<size_t>(image.width());
+    let const pixels = reinterpret_cast<uint8_t const*>(image.pixels().data());
 
-    vector<rle_image::Row> rows;
-    rows.reserve(image.height());
+    // runs of the current row are collected in a scratch buffer first, so each row is allocated only once
+    let scratch = rle_image::Row(width);
 
-    for (int x = 0, y = 0; y < image.height(); x = 0, ++y)
-        rows.emplace_back([&]() {
-            rle_image::Row row;
-            for (auto run = readOne(x, y); run.length > 0; run = readOne(x, y), x += row.back().length)
-                row.emplace_back(move(run));
-            return row;
-        }());
+    let rows = vector<rle_image::Row>(image.height());
+    for (size_t y = 0; y < rows.size(); ++y)
+    {
+        let out = scratch.data();
+        scanRuns(pixels + 3 * width * y, width, [&](uint8_t const* color, size_t length) {
+            *out++ = {static_cast<uint8_t>(length), color::rgb_color{color[0], color[1], color[2]}};
+        });
+        rows[y].assign(scratch.data(), out);
+    }
 
     return rle_image{dimension{image.width(), image.height()}, move(rows)};
 }
 
 void draw(widget& target, const rle_image& source, point top_left)
 {
-    for (int x = 0, y = 0; y < source.dim().height; x = 0, ++y)
-        for (rle_image::Run const& run : source.row(y))
-            for (unsigned i = 0; i < run.length; ++i, ++x)
-                target[top_left + point{x, y}] = run.color;
+    draw(target, source, top_left, {{0, 0}, target.size()});
 }
 
 void draw(widget& target, const rle_image& source, point top_left, color::rgb_color colorkey)
 {
-    for (int x = 0, y = 0; y < source.dim().height; x = 0, ++y)
-        for (rle_image::Run const& run : source.row(y))
-            for (unsigned i = 0; i < run.length; ++i, ++x)
-                if (run.color != colorkey)
-                    target[top_left + point{x, y}] = run.color;
+    draw(target, source, top_left, colorkey, {{0, 0}, target.size()});
+}
+
+void draw(widget& target, const rle_image& source, point top_left, rectangle clip)
+{
+    drawRuns(target, source, top_left, clip, [](color::rgb_color) { return true; });
+}
+
+void draw(widget& target, const rle_image& source, point top_left, color::rgb_color colorkey, rectangle clip)
+{
+    drawRuns(target, source, top_left, clip, [=](color::rgb_color color) { return color != colorkey; });
 }
 
 }  // namespace sgfx
@@ -0,0 +1,117 @@
+#include <sgfx/perf_counters.hpp>
+
+#if defined(__linux__)
+#	include <linux/perf_event.h>
+#	include <sys/syscall.h>
+#	include <unistd.h>
+#endif
+
+#include <cstring>
+
+using namespace std;
+
+namespace sgfx {
+
+char const* name(perf_event event) noexcept
+{
+	switch (event)
+	{
+		case perf_event::cycles:
+			return "cycles";
+		case perf_event::instructions:
+			return "instructions";
+		case perf_event::branch_misses:
+			return "branch-misses";
+		case perf_event::cache_misses:
+			return "cache-misses";
+	}
+	return "?";
+}
+
+perf_sample& perf_sample::operator+=(perf_sample const& other) noexcept
+{
+	for (size_t i = 0; i < perf_event_count; ++i)
+		counts[i] += other.counts[i];
+	counted |= other.counted;  // events not counted are zero, so sums can start from an empty sample
+	return *this;
+}
+
+perf_sample& perf_sample::operator-=(perf_sample const& other) noexcept
+{
+	for (size_t i = 0; i < perf_event_count; ++i)
+		counts[i] -= other.counts[i];
+	counted &= other.counted;
+	return *this;
+}
+
+#if defined(__linux__)
+
+namespace {
+
+int open_event(uint64_t config)
+{
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = config;
+	attr.inherit = 1;  // count threads started later on too, e.g. those of the thread pool
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+}
+
+}  // namespace
+
+perf_counters::perf_counters()
+{
+	uint64_t const configs[perf_event_count] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+												PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES};
+
+	for (size_t i = 0; i < perf_event_count; ++i)
+	{
+		fds_[i] = open_event(configs[i]);
+		if (fds_[i] >= 0)
+			counted_ |= 1u << i;
+	}
+}
+
+perf_counters::~perf_counters()
+{
+	for (int const fd : fds_)
+		if (fd >= 0)
+			close(fd);
+}
+
+perf_sample perf_counters::read() const noexcept
+{
+	perf_sample sample;
+	sample.counted = counted_;
+
+	for (size_t i = 0; i < perf_event_count; ++i)
+	{
+		if (fds_[i] >= 0 && ::read(fds_[i], &sample.counts[i], sizeof(uint64_t)) != sizeof(uint64_t))
+			sample.counted &= ~(1u << i);
+	}
+
+	return sample;
+}
+
+#else
+
+perf_counters::perf_counters()
+{
+	fds_.fill(-1);
+}
+
+perf_counters::~perf_counters() = default;
+
+perf_sample perf_counters::read() const noexcept
+{
+	return {};
+}
+
+#endif
+
+}  // namespace sgfx
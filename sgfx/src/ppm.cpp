@@ -1,157 +1,576 @@
-#include <iostream>
 #include <sgfx/ppm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <numeric>
 #include <vector>
 
+#if defined(__SSE2__) && defined(__GNUC__)
+#    define SGFX_PPM_SSE2 1
+#    include <emmintrin.h>
+#endif
+
 #define let auto /* Pure provocation with respect to my dire love to F# & my hate to C++ auto keyword. */
 
 namespace sgfx::ppm {
 
 using namespace std;
 
-canvas Parser::parseString(std::string const& data)
-{
-    offset_ = 0;
-    source_ = &data;
-    consumeToken();  // initialize tokenizer
-
-    parseMagic();
-    let dim = parseDimension();
-
-    /*let maximumColorValue = */ parseNumber();
+namespace {
 
-    let pixels = vector<color::rgb_color>{};
-    pixels.reserve(dim.width * dim.height);
+/// Pixel data smaller than this is parsed on the calling thread, as splitting it would not pay off.
+constexpr size_t parallelThreshold = 4 << 20;
 
-    while (!eof())
-        pixels.emplace_back(parsePixel());
+/// Lower bound of the size of the chunks parsed concurrently.
+constexpr size_t minimumChunkSize = 1 << 20;
 
-    return canvas{dim, move(pixels)};
+// locale independent, unlike isspace()
+constexpr bool isWhitespace(char ch) noexcept
+{
+    return ch == ' ' || (ch >= '\t' && ch <= '\r');
 }
 
-void Parser::fatalSyntaxError(std::string const& diagnosticMessage)
+/// Packs the four characters at @p p into a word, the first one in the lowest byte.
+uint32_t loadWord(char const* p) noexcept
 {
-    throw FileFormatError{diagnosticMessage};
+    let const bytes = reinterpret_cast<unsigned char const*>(p);
+    return uint32_t{bytes[0]} | uint32_t{bytes[1]} << 8 | uint32_t{bytes[2]} << 16 | uint32_t{bytes[3]} << 24;
 }
 
-char Parser::currentChar() const noexcept
+/// Computes the value of the leading @p length (1 to 3) decimal digits in @p word, see loadWord().
+unsigned decodeDigits(uint32_t word, unsigned length) noexcept
 {
-    return offset_ < source_->size() ? source_->at(offset_) : '\0';
+    // move the digits into the top bytes, so that the hundreds always end up in byte 1
+    let const digits = (word ^ 0x30303030u) << (8 * (4 - length));
+    return ((digits >> 8) & 0xFF) * 100 + ((digits >> 16) & 0xFF) * 10 + (digits >> 24);
 }
 
-char Parser::peekChar() const noexcept
+/// Counts the leading decimal digits in @p word, see loadWord().
+unsigned countDigits(uint32_t word) noexcept
 {
-    return offset_ + 1 < source_->size() ? source_->at(offset_ + 1) : '\0';
+    // per byte: (value & 0x7F) + 0x76 sets the top bit for values of 10 and above, without carrying over
+    let const values = word ^ 0x30303030u;
+    let const nonDigits = (((values & 0x7F7F7F7Fu) + 0x76767676u) | values) & 0x80808080u;
+    if (nonDigits == 0)
+        return 4;
+#if defined(__GNUC__)
+    return static_cast<unsigned>(__builtin_ctz(nonDigits)) / 8;
+#else
+    let count = 0u;
+    while (!(nonDigits & (0x80u << (8 * count))))
+        ++count;
+    return count;
+#endif
 }
 
-char Parser::nextChar() noexcept
+#if defined(SGFX_PPM_SSE2)
+/// Sets the bytes of @p chunk that are whitespace, see isWhitespace().
+__m128i whitespaceMask(__m128i chunk) noexcept
 {
-    if (offset_ < source_->size())
-        ++offset_;
-
-    return currentChar();
+    __m128i const control = _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8('\t' - 1)),
+                                          _mm_cmplt_epi8(chunk, _mm_set1_epi8('\r' + 1)));
+    return _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), control);
 }
-
-Parser::TokenInfo Parser::consumeToken()
+#endif
+
+/**
+ * Counts the whitespace separated words in [@p p, @p end), which must start at the beginning of a line.
+ *
+ * Comments are skipped, so for valid pixel data this is the number of channels.
+ */
+size_t countWords(char const* p, char const* end) noexcept
 {
-    let const consumeOneToken = [this]() -> TokenInfo {
-        // consume any leading spaces
-        while (!eof() && isspace(currentChar()))
-            nextChar();
+    size_t count = 0;
+    let inWord = false;
 
-        if (eof())
-            return TokenInfo{Token::Eof, "EOF"};
-
-        if (currentChar() == '#')  // parse comment
+    let const scalarStep = [&]() {
+        if (*p == '#')
         {
-            nextChar();  // skip '#'
-            let text = string{};
-            while (!eof() && currentChar() != '\n')
-            {
-                text += currentChar();
-                nextChar();
-            }
-            return TokenInfo{Token::Comment, text};
+            let const lineEnd = static_cast<char const*>(memchr(p, '\n', end - p));
+            p = lineEnd ? lineEnd : end;
+            inWord = false;
+            return;
         }
 
-        if (currentChar() == 'P' && peekChar() == '3')
-        {
-            nextChar();  // skip P
-            nextChar();  // skip 3
-            return TokenInfo{Token::Magic, "P3"};
-        }
+        let const space = isWhitespace(*p++);
+        count += !space && !inWord;
+        inWord = !space;
+    };
 
-        if (isdigit(currentChar()))
+#if defined(SGFX_PPM_SSE2)
+    // counts the starts of words 16 characters at a time, as long as there is no comment in between
+    while (end - p >= 16)
+    {
+        __m128i const chunk = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('#'))))
         {
-            let literal = string{};
-            literal += currentChar();
-            while (isdigit(nextChar()))
-                literal += currentChar();
-            return TokenInfo{Token::Number, literal};
+            for (let const blockEnd = p + 16; p < blockEnd;)
+                scalarStep();
+            continue;
         }
 
-        return TokenInfo{Token::Invalid, string(1, currentChar())};
+        let const words = ~static_cast<unsigned>(_mm_movemask_epi8(whitespaceMask(chunk))) & 0xFFFF;
+        let const starts = words & ~((words << 1) | unsigned{inWord});
+        count += static_cast<size_t>(__builtin_popcount(starts));
+        inWord = (words >> 15) != 0;
+        p += 16;
+    }
+#endif
+
+    while (p < end)
+        scalarStep();
+
+    return count;
+}
+
+}  // namespace
+
+canvas Parser::parseString(std::string_view data)
+{
+    return parse(data, nullptr);
+}
+
+canvas Parser::parseString(std::string_view data, thread_pool& pool)
+{
+    return parse(data, &pool);
+}
+
+canvas Parser::parse(std::string_view data, thread_pool* pool)
+{
+    current_ = data.data();
+    end_ = data.data() + data.size();
+
+    let const format = parseMagic();
+    let dim = parseDimension();
+
+    let const maximumColorValue = parseNumber();
+
+    let pixels = vector<color::rgb_color>(static_cast<size_t>(dim.width) * dim.height);
+
+    if (format == Format::Binary)
+    {
+        // a single whitespace character separates the header from the binary pixel data
+        if (maximumColorValue > 255)
+            fatalSyntaxError("Only maximum color values of up to 255 are supported.");
+        if (eof() || !isWhitespace(*current_))
+            fatalSyntaxError("Expected whitespace before the pixel data.");
+        ++current_;
+
+        let const size = 3 * pixels.size();
+        let const available = static_cast<size_t>(end_ - current_);
+        if (available < size)
+            fatalSyntaxError("Unexpected end of pixel data.");
+        if (available > size)
+            fatalSyntaxError("Unexpected data after the last pixel.");
+
+        memcpy(pixels.data(), current_, size);
+        current_ = end_;
+        return canvas{dim, move(pixels)};
+    }
+
+    // The shared pool is only brought up once it is needed. Should the concurrent path fail on malformed
+    // data, the sequential one runs into the same error and reports it.
+    let const parallel = static_cast<size_t>(end_ - current_) >= parallelThreshold
+                         && parsePixelsParallel(pixels.data(), pixels.size(),
+                                                pool ? *pool : thread_pool::shared());
+    if (!parallel)
+    {
+        parsePixels(pixels.data(), pixels.size());
+
+        skipWhitespaceAndComments();
+        if (!eof())
+            fatalSyntaxError("Unexpected data after the last pixel.");
+    }
+
+    return canvas{dim, move(pixels)};
+}
+
+/**
+ * Parses the remaining input into @p count @p pixels on @p pool.
+ *
+ * The input is split after line breaks, so that neither numbers nor comments straddle two chunks. The words
+ * in each chunk are counted concurrently, which yields the channel each chunk starts at, and then each
+ * chunk is parsed straight into its part of @p pixels.
+ *
+ * @returns false if the input was left untouched, either because it cannot be split or is malformed.
+ */
+bool Parser::parsePixelsParallel(color::rgb_color* pixels, size_t count, thread_pool& pool)
+{
+    if (pool.concurrency() < 2)
+        return false;
+
+    // a few chunks per thread balance out chunks that take longer, e.g. due to comments
+    let const size = static_cast<size_t>(end_ - current_);
+    let const chunkCount = min(size_t{pool.concurrency()} * 4, size / minimumChunkSize);
+
+    let bounds = vector<char const*>{current_};
+    for (size_t k = 1; k < chunkCount; ++k)
+    {
+        let const split = current_ + size * k / chunkCount;
+        if (split <= bounds.back())
+            continue;
+
+        let const lineEnd = static_cast<char const*>(memchr(split, '\n', end_ - split));
+        if (!lineEnd || lineEnd + 1 == end_)
+            break;
+        bounds.push_back(lineEnd + 1);
+    }
+    bounds.push_back(end_);
+
+    let const chunks = bounds.size() - 1;
+    if (chunks < 2)
+        return false;
+
+    let offsets = vector<size_t>(chunks + 1);
+    pool.parallel_for(chunks, [&](size_t k) { offsets[k + 1] = countWords(bounds[k], bounds[k + 1]); });
+    partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    if (offsets.back() != 3 * count)
+        return false;
+
+    try
+    {
+        pool.parallel_for(chunks, [&](size_t k) {
+            let chunk = Parser{};
+            chunk.current_ = bounds[k];
+            chunk.end_ = bounds[k + 1];
+            chunk.parseChannels(pixels, offsets[k], offsets[k + 1] - offsets[k]);
+
+            chunk.skipWhitespaceAndComments();
+            if (!chunk.eof())
+                chunk.fatalSyntaxError("Unexpected data after the last pixel.");
+        });
+    }
+    catch (FileFormatError const&)
+    {
+        return false;
+    }
+
+    current_ = end_;
+    return true;
+}
+
+/// Parses @p count channels into @p pixels, starting with channel number @p first.
+void Parser::parseChannels(color::rgb_color* pixels, size_t first, size_t count)
+{
+    let const channel = [](color::rgb_color& pixel, size_t index) -> uint8_t& {
+        return index == 0 ? pixel.red() : index == 1 ? pixel.green() : pixel.blue();
     };
 
-    do
-        currentToken_ = consumeOneToken();
-    while (currentToken_.token == Token::Comment);
+    // finish the pixel the previous chunk started
+    let pixel = pixels + first / 3;
+    if (let index = first % 3; index != 0)
+    {
+        for (; index < 3 && count > 0; ++index, --count)
+            channel(*pixel, index) = parseChannel();
+        ++pixel;
+    }
+
+    parsePixels(pixel, count / 3);
+    pixel += count / 3;
+
+    // start the pixel the next chunk finishes
+    for (size_t index = 0; index < count % 3; ++index)
+        channel(*pixel, index) = parseChannel();
+}
+
+void Parser::parsePixels(color::rgb_color* pixels, size_t count)
+{
+    for (size_t i = 0; i < count;)
+    {
+        // the general path takes over where the fast one gives up, e.g. for comments or errors
+        i += parsePixelsFast(pixels + i, count - i);
+        if (i < count)
+            pixels[i++] = parsePixel();
+    }
+}
+
+void Parser::fatalSyntaxError(std::string const& diagnosticMessage)
+{
+    throw FileFormatError{diagnosticMessage};
+}
 
-    return currentToken_;
+void Parser::skipWhitespaceAndComments() noexcept
+{
+    while (current_ != end_)
+    {
+        if (isWhitespace(*current_))
+            ++current_;
+        else if (*current_ == '#')  // comments extend to the end of the line
+        {
+            let const lineEnd = static_cast<char const*>(memchr(current_, '\n', end_ - current_));
+            current_ = lineEnd ? lineEnd : end_;
+        }
+        else
+            break;
+    }
 }
 
-string Parser::consumeToken(Token token)
+optional<Header> Parser::parseHeader(std::string_view data)
 {
-    if (currentToken().token != token)
-        fatalSyntaxError("Unexpected token.");
+    current_ = data.data();
+    end_ = data.data() + data.size();
 
-    let literal = currentToken().literal;
-    consumeToken();
-    return literal;
+    try
+    {
+        let const format = parseMagic();
+        let const dim = parseDimension();
+        let const maximumColorValue = parseNumber();
+
+        // a single whitespace character separates the header from the pixel data
+        if (eof())
+            return nullopt;
+        if (!isWhitespace(*current_))
+            fatalSyntaxError("Expected whitespace before the pixel data.");
+        if (format == Format::Binary && maximumColorValue > 255)
+            fatalSyntaxError("Only maximum color values of up to 255 are supported.");
+        ++current_;
+
+        return Header{format, dim, maximumColorValue, static_cast<size_t>(current_ - data.data())};
+    }
+    catch (FileFormatError const&)
+    {
+        // running out of data, or into a lone 'P' that may yet become a magic number, is no error here
+        if (eof() || (end_ - current_ == 1 && *current_ == 'P'))
+            return nullopt;
+        throw;
+    }
 }
 
-string Parser::parseMagic()
+Format Parser::parseMagic()
 {
-    if (currentToken().token != Token::Magic)
+    skipWhitespaceAndComments();
+    if (end_ - current_ < 2 || current_[0] != 'P' || (current_[1] != '3' && current_[1] != '6'))
         fatalSyntaxError("Expected Magic.");
 
-    let id = currentToken().literal;
-    consumeToken();
-    return id;
+    let const format = current_[1] == '3' ? Format::Plain : Format::Binary;
+    current_ += 2;
+    return format;
 }
 
 dimension Parser::parseDimension()
 {
-    let width = stoi(consumeToken(Token::Number));
-    let height = stoi(consumeToken(Token::Number));
-    return dimension{width, height};
+    let const width = parseNumber();
+    let const height = parseNumber();
+
+    if (width > numeric_limits<uint16_t>::max() || height > numeric_limits<uint16_t>::max())
+        fatalSyntaxError("Image dimension out of range.");
+
+    return dimension{static_cast<int>(width), static_cast<int>(height)};
 }
 
 color::rgb_color Parser::parsePixel()
 {
-    let const parsePixel = [this]() -> uint8_t {
-        int value = parseNumber();
-        if (value >= 0 && value <= 255)
-            return static_cast<uint8_t>(value);
-        fatalSyntaxError("Pixel value out of range.");
-        return 0;  // never reached
+    let const red = parseChannel();
+    let const green = parseChannel();
+    let const blue = parseChannel();
+
+    return color::rgb_color{red, green, blue};
+}
+
+size_t Parser::parsePixelsFast(color::rgb_color* pixels, size_t count) noexcept
+{
+    // Keeps the read position in a local, as the pixel stores could otherwise alias the member.
+    let p = current_;
+    let const end = end_;
+    size_t i = 0;
+
+#if defined(SGFX_PPM_SSE2)
+    // Classifies 16 characters at once, which is enough to hold a pixel of three-digit channels, and
+    // computes the value of the number ending at each of them. The channel boundaries then follow from
+    // the digit mask with bit operations, rather than from a chain of dependent loads per character.
+    let const isBetween = [](__m128i chunk, char low, char high) {
+        return _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8(low - 1)),
+                             _mm_cmplt_epi8(chunk, _mm_set1_epi8(high + 1)));
+    };
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const ten = _mm_set1_epi16(10);
+    __m128i const hundred = _mm_set1_epi16(100);
+    alignas(16) uint16_t values[16];
+
+    for (; i < count && end - p >= 16; ++i)
+    {
+        __m128i const chunk = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p));
+        __m128i const isDigit = isBetween(chunk, '0', '9');
+        let const digits = static_cast<unsigned>(_mm_movemask_epi8(isDigit));
+        let const spaces = static_cast<unsigned>(_mm_movemask_epi8(whitespaceMask(chunk)));
+
+        // last digit of each number; clearing the lowest bit moves on to the next number
+        let const ends = digits & ~(digits >> 1);
+        let const ends1 = ends & (ends - 1);
+        let const ends2 = ends1 & (ends1 - 1);
+        let const last = static_cast<unsigned>(__builtin_ctz(ends2 | 0x10000));
+
+        // The third number must be terminated within the chunk, with nothing but whitespace in between.
+        // Longer numbers, such as ones with leading zeros, are left to the general path.
+        let const used = (2u << last) - 1;
+        let const longNumbers = digits & (digits << 1) & (digits << 2) & (digits << 3);
+        if (last >= 15 || (used & (~(digits | spaces) | longNumbers)) != 0)
+            break;
+
+        // digit values d, and per position d[k] + 10 * d[k - 1] + 100 * d[k - 2] within a run of digits
+        __m128i const d0 = _mm_and_si128(_mm_sub_epi8(chunk, _mm_set1_epi8('0')), isDigit);
+        __m128i const d1 = _mm_slli_si128(d0, 1);
+        __m128i const d2 = _mm_and_si128(_mm_slli_si128(d0, 2), _mm_slli_si128(isDigit, 1));
+        let const combine = [&](bool high) {
+            let const widen = [&](__m128i v) {
+                return high ? _mm_unpackhi_epi8(v, zero) : _mm_unpacklo_epi8(v, zero);
+            };
+            return _mm_add_epi16(_mm_add_epi16(widen(d0), _mm_mullo_epi16(widen(d1), ten)),
+                                 _mm_mullo_epi16(widen(d2), hundred));
+        };
+        _mm_store_si128(reinterpret_cast<__m128i*>(values), combine(false));
+        _mm_store_si128(reinterpret_cast<__m128i*>(values + 8), combine(true));
+
+        let const red = values[__builtin_ctz(ends)];
+        let const green = values[__builtin_ctz(ends1)];
+        let const blue = values[last];
+        if ((red | green | blue) > 255)
+            break;
+
+        pixels[i] = color::rgb_color{static_cast<uint8_t>(red), static_cast<uint8_t>(green),
+                                     static_cast<uint8_t>(blue)};
+        p += last + 1;
+    }
+#endif
+
+    // Looks at four characters at once to find the length of a number without a branch per digit.
+    let const parseChannel = [&p, end](uint8_t& channel) -> bool {
+        while (p != end && isWhitespace(*p))
+            ++p;
+
+        if (end - p < 4)
+            return false;
+
+        let const word = loadWord(p);
+        let const length = countDigits(word);
+        if (length < 1 || length > 3)
+            return false;
+
+        let const value = decodeDigits(word, length);
+        if (value > 255)
+            return false;
+
+        channel = static_cast<uint8_t>(value);
+        p += length;
+        return true;
     };
 
-    let const red = parsePixel();
-    let const green = parsePixel();
-    let const blue = parsePixel();
-    let const color = color::rgb_color{red, green, blue};
+    for (; i < count; ++i)
+    {
+        let const pixelStart = p;
+        uint8_t red, green, blue;
+        if (!parseChannel(red) || !parseChannel(green) || !parseChannel(blue))
+        {
+            p = pixelStart;
+            break;
+        }
+        pixels[i] = color::rgb_color{red, green, blue};
+    }
 
-    return color;
+    current_ = p;
+    return i;
 }
 
-int Parser::parseNumber()
+uint8_t Parser::parseChannel()
 {
-    if (currentToken().token != Token::Number)
-        fatalSyntaxError("Expected a number.");
+    let const value = parseNumber();
+    if (value > 255)
+        fatalSyntaxError("Pixel value out of range.");
+    return static_cast<uint8_t>(value);
+}
 
-    let number = stoi(currentToken().literal);
-    consumeToken();
-    return number;
+unsigned Parser::parseNumber()
+{
+    skipWhitespaceAndComments();
+
+    let value = 0u;
+    let const [next, ec] = from_chars(current_, end_, value);
+    if (ec != errc{})
+        fatalSyntaxError(ec == errc::result_out_of_range ? "Number out of range." : "Expected a number.");
+
+    current_ = next;
+    return value;
+}
+
+// -------------------------------------------------------------------------
+// Writer
+
+namespace {
+
+/// Decimal representation of a channel value, followed by a space.
+struct Decimal {
+    char text[4];
+    uint8_t length;
+};
+
+constexpr array<Decimal, 256> makeDecimals()
+{
+    let decimals = array<Decimal, 256>{};
+    for (unsigned value = 0; value < 256; ++value)
+    {
+        let& decimal = decimals[value];
+        let length = uint8_t{0};
+        if (value >= 100)
+            decimal.text[length++] = static_cast<char>('0' + value / 100);
+        if (value >= 10)
+            decimal.text[length++] = static_cast<char>('0' + value / 10 % 10);
+        decimal.text[length++] = static_cast<char>('0' + value % 10);
+        decimal.text[length++] = ' ';
+        decimal.length = length;
+    }
+    return decimals;
+}
+
+constexpr array<Decimal, 256> decimals = makeDecimals();
+
+/// Longest line, i.e. pixel, of plain text pixel data.
+constexpr size_t maximumPixelLength = 3 * 4;
+
+}  // namespace
+
+Writer::Writer(Format format, size_t blockSize)
+    : format_{format},
+      pixelsPerBlock_{max(blockSize / maximumPixelLength, size_t{1})},
+      // each channel is copied as four characters, overshooting by up to two
+      buffer_(pixelsPerBlock_ * maximumPixelLength + 2)
+{
+}
+
+void Writer::write(dimension dim, uint8_t const* channels, Sink const& sink)
+{
+    char header[32];
+    let const headerLength = snprintf(header, sizeof(header), "P%c\n%d %d\n255\n",
+                                      format_ == Format::Plain ? '3' : '6', dim.width, dim.height);
+    sink(header, static_cast<size_t>(headerLength));
+
+    let const pixelCount = static_cast<size_t>(dim.width) * dim.height;
+    if (format_ == Format::Binary)
+    {
+        sink(reinterpret_cast<char const*>(channels), 3 * pixelCount);
+        return;
+    }
+
+    // one pixel per line, keeping lines well below the 70 characters the format recommends
+    for (size_t i = 0; i < pixelCount; i += pixelsPerBlock_)
+    {
+        let const end = channels + 3 * min(pixelsPerBlock_, pixelCount - i);
+        let out = buffer_.data();
+        for (; channels != end; channels += 3)
+        {
+            for (size_t c = 0; c < 3; ++c)
+            {
+                let const& decimal = decimals[channels[c]];
+                memcpy(out, decimal.text, sizeof(decimal.text));
+                out += decimal.length;
+            }
+            out[-1] = '\n';
+        }
+        sink(buffer_.data(), static_cast<size_t>(out - buffer_.data()));
+    }
 }
 
 }  // namespace sgfx::ppm
@@ -9,12 +9,10 @@
 #include <sgfx/primitives.hpp>
 
 #include <algorithm>
-#include <iostream>
-#include <tuple>
-#include <functional>
 #include <cassert>
+#include <cstdlib>
+#include <utility>
 
-using namespace std::placeholders;
 using namespace std;
 
 namespace sgfx {
@@ -25,111 +23,252 @@ void plot(widget& target, point p, color::rgb_color col)
 	p.y = min(p.y, static_cast<int>(target.height()) - 1);
 
 	target.pixels()[p.y * target.width() + p.x] = col;
+	target.damage({p, {1, 1}});
 }
 
 void clear(widget& target, color::rgb_color col)
 {
 	fill(begin(target.pixels()), end(target.pixels()), col);
+	target.damage({{0, 0}, target.size()});
 }
 
-void hline(widget& target, point p, std::uint16_t length, color::rgb_color col)
+namespace {
+
+#if defined(__SIZEOF_INT128__)
+/// Holds products of two coordinate differences, which take up to 2 * 33 bits.
+__extension__ typedef __int128 wide_int;
+#else
+/// Exact as long as coordinates stay within +-2^30.
+typedef long long wide_int;
+#endif
+
+/// Integer division rounding towards negative infinity (@p b must be positive).
+constexpr wide_int floor_div(wide_int a, wide_int b)
 {
-	if (p.y < target.height()) {
-		const int xEnd = min(p.x + length, static_cast<int>(target.width()));
-		while (p.x < xEnd) {
-			plot(target, p, col);
-			++p.x;
-		}
-	}
+	return a >= 0 ? a / b : -((-a + b - 1) / b);
 }
 
-void vline(widget& target, point p, std::uint16_t length, color::rgb_color col)
+/// Integer division rounding towards positive infinity (@p b must be positive).
+constexpr wide_int ceil_div(wide_int a, wide_int b)
 {
-	if (p.x < target.width()) {
-		const int yEnd = min(p.y + length, static_cast<int>(target.height()));
-		while (p.y < yEnd) {
-			plot(target, p, col);
-			++p.y;
-		}
-	}
+	return -floor_div(-a, b);
 }
 
-void fill(widget& target, rectangle rect, color::rgb_color col)
+/// Restricts @p clip to the bounds of @p target.
+rectangle clip_to(widget const& target, rectangle const& clip)
 {
-	if (rect.top_left == point{0, 0} && rect.size == dimension{target.width(), target.height()})
-		clear(target, col);
-	else
-		for (int i = 0; i < rect.size.height; ++i)
-			hline(target, {rect.top_left.x, rect.top_left.y + static_cast<int>(i)}, rect.size.width, col);
+	return intersection(clip, rectangle{{0, 0}, target.size()});
+}
+
+/**
+ * Fills the pixels [x0, x1] (both inclusive) of row @p y, clipped to @p clip.
+ */
+void span_fill(color::rgb_color* pixels, int stride, rectangle const& clip, int y, int x0, int x1,
+			   color::rgb_color col)
+{
+	if (y < clip.top() || y >= clip.bottom())
+		return;
+
+	x0 = max(x0, clip.left());
+	x1 = min(x1, clip.right() - 1);
+	if (x0 <= x1)
+		fill_n(pixels + y * stride + x0, x1 - x0 + 1, col);
 }
 
 /**
- * Breseham Algorithm line point generator.
+ * Fills the pixels [y0, y1] (both inclusive) of column @p x, clipped to @p clip.
+ */
+void column_fill(color::rgb_color* pixels, int stride, rectangle const& clip, int x, int y0, int y1,
+				 color::rgb_color col)
+{
+	if (x < clip.left() || x >= clip.right())
+		return;
+
+	y0 = max(y0, clip.top());
+	y1 = min(y1, clip.bottom() - 1);
+	for (auto p = pixels + y0 * stride + x; y0 <= y1; ++y0, p += stride)
+		*p = col;
+}
+
+/**
+ * Breseham Algorithm line point generator, clipped to the rectangle @p clip.
+ *
+ * The line is clipped parametrically (Liang-Barsky style) along the walking coordinate before
+ * any point is generated, and the decision variable is resumed at the first visible step,
+ * so the generated points are exactly those of the unclipped line that lie inside the clip area.
  *
  * @param A indexed access to point coordinate, where 0 means X and 1 means Y.
  * @param B indexed access to point coordinate, where 0 means X and 1 means Y.
  *
  * @param p0 first point
  * @param p1 second point
- * @param drawer function to invoke for each generated point.
+ * @param clip area to clip the generated points to.
+ * @param sink function object to invoke for each generated point.
  */
-template <const size_t A, const size_t B>
-constexpr void breseham(point p0, point p1, std::function<void(point const&)> sink) {
+template <const size_t A, const size_t B, typename Sink>
+void breseham(point p0, point p1, rectangle const& clip, Sink sink)
+{
 	static_assert(A == 0 || A == 1, "A must be 0 (for X) or 1 (for Y).");
 	static_assert(B == 0 || B == 1, "B must be 0 (for X) or 1 (for Y).");
 	static_assert(A != B, "A must not be equal to B.");
-	assert(p0.y <= p1.y && "Must draw from top to bottom (p0.y <= p1.y).");
-
-	// compute delta x/y and the increment value for the walking coordinate
-	auto const [delta, increment] = [](auto p0, auto p1) {
-		if (const auto delta = p1 - p0; get<B>(delta) >= 0)
-			return make_tuple(delta, +1);
-		else {
-			const auto sgn = int{A == 0 /*A is X*/ ? +1 : -1};
-			return make_tuple(point{sgn * delta.x, -sgn * delta.y}, -1);
-		}
-	}(p0, p1);
+	assert(get<A>(p0) < get<A>(p1) && "Must walk along increasing coordinate A.");
+
+	point const low = clip.top_left;
+	point const high = clip.top_left + point(clip.size) - point{1, 1};
+
+	// Coordinate differences of far off-screen endpoints take 33 bits, and the products of two of them
+	// used for clipping take wide_int. Once clipped, the decision variable fits into a long long again.
+	wide_int const a0 = get<A>(p0);
+	wide_int const b0 = get<B>(p0);
+	int const increment = get<B>(p1) >= get<B>(p0) ? +1 : -1;
+	wide_int const deltaA = get<A>(p1) - a0;
+	wide_int const deltaB = increment > 0 ? get<B>(p1) - b0 : b0 - get<B>(p1);
+	assert(deltaB <= deltaA);
+
+	// The point at step i is {a0 + i, b0 + increment * k(i)} with
+	// k(i) = floor((2 * deltaB * i + deltaA - 1) / (2 * deltaA)), which is monotonic in i.
+
+	// clip walking coordinate: low <= a0 + i <= high
+	auto first = max<wide_int>(0, get<A>(low) - a0);
+	auto last = min<wide_int>(deltaA, get<A>(high) - a0);
 
-	auto big_d = int{2 * get<B>(delta) - get<A>(delta)};
-	auto p = p0;
-	while (get<A>(p) <= get<A>(p1)) {
+	// clip stepping coordinate: low <= b0 + increment * k(i) <= high
+	auto const kmin = max<wide_int>(0, increment > 0 ? get<B>(low) - b0 : b0 - get<B>(high));
+	auto const kmax = min<wide_int>(deltaB, increment > 0 ? get<B>(high) - b0 : b0 - get<B>(low));
+	if (kmin > kmax)
+		return;
+
+	if (deltaB != 0) {
+		first = max(first, ceil_div(2 * deltaA * kmin - deltaA + 1, 2 * deltaB));
+		last = min(last, floor_div(2 * deltaA * (kmax + 1) - deltaA, 2 * deltaB));
+	}
+
+	if (first > last)
+		return;
+
+	// resume the decision variable at the first visible step
+	auto const k = floor_div(2 * deltaB * first + deltaA - 1, 2 * deltaA);
+	auto big_d = static_cast<long long>(2 * deltaB * (first + 1) - deltaA - 2 * deltaA * k);
+	auto p = point::indexed<A, B>(static_cast<int>(a0 + first), static_cast<int>(b0 + increment * k));
+
+	for (auto i = static_cast<long long>(first); i <= last; ++i) {
 		sink(p);
 		if (big_d > 0) {
-			big_d -= 2 * get<A>(delta);
+			big_d -= 2 * deltaA;
 			get<B>(p) += increment;
 		}
 		++get<A>(p);
-		big_d += 2 * get<B>(delta);
+		big_d += 2 * deltaB;
 	}
 }
 
-void line(widget& target, point p0, point p1, color::rgb_color col)
+/**
+ * Rasterizes the line from @p p0 to @p p1 (both inclusive) into @p pixels, clipped to @p clip.
+ */
+void rasterize_line(color::rgb_color* pixels, int stride, rectangle const& clip, point p0, point p1,
+					color::rgb_color col)
 {
-	if (p0 == p1) {
-		// point
-		plot(target, p0, col);
-	}
-	else if (p0.y == p1.y) {
-		// vertical line
-		hline(target, p0, abs(p1.x - p0.x), col);
+	auto const sink = [=](point const& p) { pixels[p.y * stride + p.x] = col; };
+
+	if (p0.y == p1.y) {
+		// horizontal line (or a single point)
+		span_fill(pixels, stride, clip, p0.y, min(p0.x, p1.x), max(p0.x, p1.x), col);
 	}
 	else if (p0.x == p1.x) {
-		// horizontal line
-		vline(target, p0, abs(p1.y - p0.y), col);
+		// vertical line
+		column_fill(pixels, stride, clip, p0.x, min(p0.y, p1.y), max(p0.y, p1.y), col);
 	}
-	else if (abs(p1.y - p0.y) < abs(p1.x - p0.x)) {
+	else if (llabs(static_cast<long long>(p1.y) - p0.y) < llabs(static_cast<long long>(p1.x) - p0.x)) {
 		// non-trivial line: with the power of Bresenham
 		if (p0.x > p1.x)
-			breseham<0, 1>(p1, p0, bind(plot, ref(target), _1, col));
-		else
-			breseham<0, 1>(p0, p1, bind(plot, ref(target), _1, col));
+			swap(p0, p1);
+		breseham<0, 1>(p0, p1, clip, sink);
 	}
 	else {
 		// non-trivial line: with the power of Bresenham
 		if (p0.y > p1.y)
-			breseham<1, 0>(p1, p0, bind(plot, ref(target), _1, col));
-		else
-			breseham<1, 0>(p0, p1, bind(plot, ref(target), _1, col));
+			swap(p0, p1);
+		breseham<1, 0>(p0, p1, clip, sink);
+	}
+}
+
+}  // namespace
+
+void hline(widget& target, point p, std::uint16_t length, color::rgb_color col)
+{
+	if (length != 0) {
+		span_fill(target.pixels().data(), target.width(), {{0, 0}, target.size()}, p.y, p.x, p.x + length - 1,
+				  col);
+		target.damage({p, {length, 1}});
+	}
+}
+
+void vline(widget& target, point p, std::uint16_t length, color::rgb_color col)
+{
+	if (length != 0) {
+		column_fill(target.pixels().data(), target.width(), {{0, 0}, target.size()}, p.x, p.y, p.y + length - 1,
+					col);
+		target.damage({p, {1, length}});
+	}
+}
+
+void fill(widget& target, rectangle rect, color::rgb_color col)
+{
+	if (rect.top_left == point{0, 0} && rect.size == dimension{target.width(), target.height()})
+		clear(target, col);
+	else
+		fill(target, rect, col, {{0, 0}, target.size()});
+}
+
+void fill(widget& target, rectangle rect, color::rgb_color col, rectangle clip)
+{
+	auto const area = intersection(rect, clip_to(target, clip));
+	if (area.empty())
+		return;
+
+	auto const stride = target.width();
+	auto row = target.pixels().data() + area.top() * stride + area.left();
+	for (int y = area.top(); y < area.bottom(); ++y, row += stride)
+		fill_n(row, area.size.width, col);
+
+	target.damage(area);
+}
+
+rectangle bounding_box(point p0, point p1, rectangle const& clip)
+{
+	// the box itself may be too large for an int, unlike its intersection with the clip area
+	auto const left = max<long long>(min(p0.x, p1.x), clip.left());
+	auto const top = max<long long>(min(p0.y, p1.y), clip.top());
+	auto const right = min(max(p0.x, p1.x) + 1ll, static_cast<long long>(clip.right()));
+	auto const bottom = min(max(p0.y, p1.y) + 1ll, static_cast<long long>(clip.bottom()));
+	if (left >= right || top >= bottom)
+		return rectangle{{0, 0}, {0, 0}};
+
+	return rectangle{{static_cast<int>(left), static_cast<int>(top)},
+					 {static_cast<int>(right - left), static_cast<int>(bottom - top)}};
+}
+
+void line(widget& target, point p0, point p1, color::rgb_color col)
+{
+	line(target, p0, p1, col, {{0, 0}, target.size()});
+}
+
+void line(widget& target, point p0, point p1, color::rgb_color col, rectangle clip)
+{
+	clip = clip_to(target, clip);
+	rasterize_line(target.pixels().data(), target.width(), clip, p0, p1, col);
+	target.damage(bounding_box(p0, p1, clip));
+}
+
+void lines(widget& target, std::pair<point, point> const* segments, std::size_t count, color::rgb_color col)
+{
+	auto const pixels = target.pixels().data();
+	auto const stride = target.width();
+	auto const clip = rectangle{{0, 0}, target.size()};
+
+	for (auto const end = segments + count; segments != end; ++segments) {
+		rasterize_line(pixels, stride, clip, segments->first, segments->second, col);
+		target.damage(bounding_box(segments->first, segments->second, clip));
 	}
 }
 
@@ -0,0 +1,219 @@
+#include <sgfx/rle_sprite.hpp>
+
+#include "file.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+
+namespace sgfx {
+
+namespace {
+
+static_assert(sizeof(color::rgb_color) == 3, "rgb_color must be tightly packed.");
+
+/**
+ * Finds the end of the encoded row at @p row, which must not extend beyond @p end.
+ *
+ * @throws std::runtime_error if it does.
+ */
+uint8_t const* skip_row(uint8_t const* row, uint8_t const* end)
+{
+	if (end - row < 2)
+		throw runtime_error{"Unexpected end of RLE sprite data."};
+
+	auto spans = row[0] | (row[1] << 8);
+	for (row += 2; spans != 0; --spans)
+	{
+		if (end - row < 2 || end - row - 2 < 3 * row[1])
+			throw runtime_error{"Unexpected end of RLE sprite data."};
+		row += 2 + 3 * row[1];
+	}
+
+	return row;
+}
+
+void put16(vector<uint8_t>& output, unsigned value)
+{
+	output.push_back(static_cast<uint8_t>(value & 0xFF));
+	output.push_back(static_cast<uint8_t>((value >> 8) & 0xFF));
+}
+
+}  // namespace
+
+rle_sprite::rle_sprite(dimension size, vector<uint8_t> data) : size_{size}, data_{move(data)}
+{
+	uint8_t const* const begin = data_.data();
+	auto const end = begin + data_.size();
+
+	rows_.resize(static_cast<size_t>(size_.height));
+	auto row = begin;
+	for (auto& offset : rows_)
+	{
+		offset = static_cast<size_t>(row - begin);
+		row = skip_row(row, end);
+	}
+
+	if (row != end)
+		throw runtime_error{"Unexpected data after the last row."};
+}
+
+rle_sprite::rle_sprite(rle_image const& image, color::rgb_color colorkey)
+{
+	auto const width = static_cast<size_t>(image.dim().width);
+	auto pixels = vector<color::rgb_color>(width);
+	auto data = vector<uint8_t>{};
+
+	// expands each row, which takes care of rows whose runs do not add up to the width
+	for (size_t y = 0; y < static_cast<size_t>(image.dim().height); ++y)
+	{
+		fill(begin(pixels), end(pixels), colorkey);
+		if (y < image.row_count())
+		{
+			size_t x = 0;
+			for (rle_image::Run const& run : image.row(y))
+			{
+				auto const count = min<size_t>(run.length, width - x);
+				fill_n(begin(pixels) + x, count, run.color);
+				if ((x += count) == width)
+					break;
+			}
+		}
+		encode_row(reinterpret_cast<uint8_t const*>(pixels.data()), width, colorkey, data);
+	}
+
+	*this = rle_sprite{image.dim(), move(data)};
+}
+
+rle_sprite::rle_sprite(widget const& image, color::rgb_color colorkey)
+{
+	auto const width = static_cast<size_t>(image.width());
+	auto const pixels = reinterpret_cast<uint8_t const*>(image.pixels().data());
+
+	auto data = vector<uint8_t>{};
+	for (size_t y = 0; y < image.height(); ++y)
+		encode_row(pixels + 3 * width * y, width, colorkey, data);
+
+	*this = rle_sprite{image.size(), move(data)};
+}
+
+rle_sprite rle_sprite::load(string const& data)
+{
+	if (data.size() < 4)
+		throw runtime_error{"Unexpected end of RLE sprite data."};
+
+	auto const header = reinterpret_cast<uint8_t const*>(data.data());
+	auto const width = header[0] | (header[1] << 8);
+	auto const height = header[2] | (header[3] << 8);
+
+	return rle_sprite{dimension{width, height}, vector<uint8_t>(header + 4, header + data.size())};
+}
+
+void rle_sprite::encode_row(uint8_t const* pixels, size_t count, color::rgb_color colorkey,
+							vector<uint8_t>& output)
+{
+	uint8_t const key[3] = {colorkey.red(), colorkey.green(), colorkey.blue()};
+	auto const transparent = [&](size_t x) { return memcmp(pixels + 3 * x, key, 3) == 0; };
+
+	// the number of spans precedes them, so it is patched in once they are known
+	auto const start = output.size();
+	output.resize(start + 2);
+
+	unsigned spans = 0;
+	for (size_t x = 0; x < count; ++spans)
+	{
+		size_t skip = 0;
+		for (; x < count && transparent(x); ++x)
+			++skip;
+
+		// transparency up to the end of the row needs no span at all
+		if (x == count)
+			break;
+
+		for (; skip > 255; skip -= 255, ++spans)
+		{
+			output.push_back(255);
+			output.push_back(0);
+		}
+
+		auto const first = x;
+		while (x < count && x - first < 255 && !transparent(x))
+			++x;
+
+		output.push_back(static_cast<uint8_t>(skip));
+		output.push_back(static_cast<uint8_t>(x - first));
+		output.insert(end(output), pixels + 3 * first, pixels + 3 * x);
+	}
+
+	output[start] = static_cast<uint8_t>(spans & 0xFF);
+	output[start + 1] = static_cast<uint8_t>((spans >> 8) & 0xFF);
+}
+
+rle_sprite load_rle_sprite(string const& path)
+{
+	return rle_sprite::load(detail::readFile(path));
+}
+
+void save_rle_sprite(rle_sprite const& source, string const& path)
+{
+	auto header = vector<uint8_t>{};
+	put16(header, static_cast<unsigned>(source.size().width));
+	put16(header, static_cast<unsigned>(source.size().height));
+
+	auto os = ofstream{path, ios::binary};
+	if (!os.is_open())
+		throw runtime_error{"Could not open file."};
+
+	auto const& data = source.data();
+	os.write(reinterpret_cast<char const*>(header.data()), static_cast<streamsize>(header.size()));
+	os.write(reinterpret_cast<char const*>(data.data()), static_cast<streamsize>(data.size()));
+	if (!os)
+		throw runtime_error{"Could not write file."};
+}
+
+void draw(widget& target, rle_sprite const& source, point top_left)
+{
+	draw(target, source, top_left, {{0, 0}, target.size()});
+}
+
+void draw(widget& target, rle_sprite const& source, point top_left, rectangle clip)
+{
+	auto const area = intersection(intersection(rectangle{top_left, source.size()}, clip),
+								   rectangle{{0, 0}, target.size()});
+	if (area.empty())
+		return;
+
+	auto const stride = target.width();
+	for (int y = area.top(); y < area.bottom(); ++y)
+	{
+		auto const row = target.pixels().data() + y * stride;
+		auto span = source.row(static_cast<size_t>(y - top_left.y));
+		auto spans = span[0] | (span[1] << 8);
+		auto x = top_left.x;
+
+		for (span += 2; spans != 0; --spans)
+		{
+			auto const count = span[1];
+			x += span[0];
+			if (x >= area.right())
+				break;
+
+			// opaque pixels are stored just like a row of rgb_color, so visible ones are copied as is
+			auto const from = max(x, area.left());
+			auto const to = min(x + count, area.right());
+			if (from < to)
+				memcpy(row + from, span + 2 + 3 * (from - x), 3 * static_cast<size_t>(to - from));
+
+			x += count;
+			span += 2 + 3 * count;
+		}
+	}
+
+	target.damage(area);
+}
+
+}  // namespace sgfx
@@ -0,0 +1,224 @@
+#include <sgfx/scale.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#	include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace sgfx {
+
+namespace {
+
+static_assert(sizeof(color::rgb_color) == 3, "rgb_color must be tightly packed.");
+
+using byte = uint8_t;
+
+/// Fixed point precision of the interpolation weights, i.e. weights are in [0, weight_one).
+constexpr int weight_bits = 7;
+constexpr int weight_one = 1 << weight_bits;
+
+/// Output columns processed at a time, so that the intermediate rows of the bilinear filter stay in L1 cache.
+constexpr int strip_width = 512;
+
+/// Horizontal sampling position of one output column.
+struct tap {
+	unsigned left;    ///< byte offset of the left source pixel within its row
+	unsigned right;   ///< byte offset of the right source pixel within its row
+	int16_t weight;   ///< weight of the right source pixel
+};
+
+/// Maps output coordinate @p u of an axis sized @p to onto the closest pixel of a source axis sized @p from.
+int nearest_coordinate(int u, int to, int from)
+{
+	return static_cast<int>((int64_t{2 * u + 1} * from) / (2 * to));
+}
+
+/**
+ * Maps output coordinate @p u of an axis of length @p to onto a source axis of length @p from.
+ *
+ * Pixel centers are mapped half-pixel aligned, i.e. both axes span the same extent with each pixel
+ * sampled at its center, and positions beyond the first or last source pixel center are clamped to it.
+ *
+ * @returns the index of the lower source pixel and the weight of the upper one.
+ */
+pair<int, int> linear_coordinate(int u, int to, int from)
+{
+	// (u + 1/2) * from / to - 1/2, in units of 1 / weight_one
+	auto const pos = (int64_t{2 * u + 1} * from * weight_one) / (2 * to) - weight_one / 2;
+	if (pos <= 0)
+		return {0, 0};
+
+	auto const index = static_cast<int>(pos >> weight_bits);
+	if (index >= from - 1)
+		return {from - 1, 0};
+
+	return {index, static_cast<int>(pos & (weight_one - 1))};
+}
+
+/// Horizontal pass: interpolates @p count output pixels of source row @p src into 16-bit channels.
+void filter_row(byte const* src, tap const* taps, int count, int16_t* out)
+{
+	for (tap const* const end = taps + count; taps != end; ++taps, out += 3)
+	{
+		int const w = taps->weight;
+		for (int c = 0; c < 3; ++c)
+			out[c] = static_cast<int16_t>(src[taps->left + c] * (weight_one - w) + src[taps->right + c] * w);
+	}
+}
+
+/// Vertical pass: interpolates @p count channels between rows @p a and @p b, @p w being the weight of @p b.
+void blend_rows(int16_t const* a, int16_t const* b, int w, size_t count, byte* out)
+{
+	constexpr int shift = 2 * weight_bits;
+	constexpr int rounding = 1 << (shift - 1);
+
+	size_t i = 0;
+#if defined(__SSE2__)
+	__m128i const weights = _mm_set1_epi32((w << 16) | (weight_one - w));
+	__m128i const bias = _mm_set1_epi32(rounding);
+	auto const blend8 = [&](size_t j) {
+		__m128i const va = _mm_loadu_si128(reinterpret_cast<__m128i const*>(a + j));
+		__m128i const vb = _mm_loadu_si128(reinterpret_cast<__m128i const*>(b + j));
+		__m128i const lo = _mm_madd_epi16(_mm_unpacklo_epi16(va, vb), weights);
+		__m128i const hi = _mm_madd_epi16(_mm_unpackhi_epi16(va, vb), weights);
+		return _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(lo, bias), shift),
+							   _mm_srai_epi32(_mm_add_epi32(hi, bias), shift));
+	};
+	for (; i + 16 <= count; i += 16)
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(blend8(i), blend8(i + 8)));
+#endif
+	for (; i < count; ++i)
+		out[i] = static_cast<byte>((a[i] * (weight_one - w) + b[i] * w + rounding) >> shift);
+}
+
+void scale_nearest(widget& target, canvas const& source, rectangle const& area, rectangle const& visible)
+{
+	int const sourceWidth = source.width();
+	int const width = visible.size.width;
+	int const left = visible.left() - area.left();
+	auto const stride = target.width();
+	auto dst = target.pixels().data() + visible.top() * stride + visible.left();
+
+	// integer upscaling replicates each source pixel a fixed number of times, which is filled in runs
+	int const factor = area.size.width % sourceWidth == 0 ? area.size.width / sourceWidth : 0;
+
+	vector<int> columns;
+	if (!factor)
+	{
+		columns.resize(width);
+		for (int x = 0; x < width; ++x)
+			columns[x] = nearest_coordinate(left + x, area.size.width, sourceWidth);
+	}
+
+	int previous = -1;
+	for (int y = 0; y < visible.size.height; ++y, dst += stride)
+	{
+		int const sy = nearest_coordinate(visible.top() - area.top() + y, area.size.height, source.height());
+		if (sy == previous)
+		{
+			copy_n(dst - stride, width, dst);
+			continue;
+		}
+		previous = sy;
+
+		auto const row = source.pixels().data() + sy * sourceWidth;
+		if (factor)
+		{
+			for (int x = 0, u = left; x < width;)
+			{
+				int const run = min(factor - u % factor, width - x);
+				fill_n(dst + x, run, row[u / factor]);
+				x += run;
+				u += run;
+			}
+		}
+		else
+		{
+			for (int x = 0; x < width; ++x)
+				dst[x] = row[columns[x]];
+		}
+	}
+}
+
+void scale_bilinear(widget& target, canvas const& source, rectangle const& area, rectangle const& visible)
+{
+	int const sourceWidth = source.width();
+	auto const src = reinterpret_cast<byte const*>(source.pixels().data());
+	auto const stride = 3 * target.width();
+
+	vector<tap> taps(visible.size.width);
+	for (int x = 0; x < visible.size.width; ++x)
+	{
+		auto const [index, weight] = linear_coordinate(visible.left() - area.left() + x, area.size.width,
+													   sourceWidth);
+		auto const next = min(index + 1, sourceWidth - 1);
+		taps[x] = {static_cast<unsigned>(3 * index), static_cast<unsigned>(3 * next),
+				   static_cast<int16_t>(weight)};
+	}
+
+	vector<pair<int, int>> rows(visible.size.height);
+	for (int y = 0; y < visible.size.height; ++y)
+		rows[y] = linear_coordinate(visible.top() - area.top() + y, area.size.height, source.height());
+
+	// horizontally filtered source rows, cached by the parity of their index, as each output row needs two
+	// adjacent ones and consecutive output rows mostly share them
+	vector<int16_t> filtered[2] = {vector<int16_t>(3 * strip_width), vector<int16_t>(3 * strip_width)};
+
+	for (int x0 = 0; x0 < visible.size.width; x0 += strip_width)
+	{
+		int const count = min(strip_width, visible.size.width - x0);
+		int cached[2] = {-1, -1};
+		auto const filteredRow = [&](int sy) {
+			auto& row = filtered[sy & 1];
+			if (cached[sy & 1] != sy)
+			{
+				filter_row(src + 3 * sy * sourceWidth, taps.data() + x0, count, row.data());
+				cached[sy & 1] = sy;
+			}
+			return row.data();
+		};
+
+		auto out = reinterpret_cast<byte*>(target.pixels().data() + visible.top() * target.width()
+										   + visible.left() + x0);
+		for (auto const& [sy, weight] : rows)
+		{
+			int16_t const* const upper = filteredRow(sy);
+			int16_t const* const lower = weight ? filteredRow(sy + 1) : upper;
+			blend_rows(upper, lower, weight, 3 * count, out);
+			out += stride;
+		}
+	}
+}
+
+}  // namespace
+
+canvas scale(canvas const& source, dimension size, scale_filter filter)
+{
+	canvas result{size};
+	scale(result, source, {{0, 0}, size}, filter);
+	return result;
+}
+
+void scale(widget& target, canvas const& source, rectangle area, scale_filter filter)
+{
+	auto const visible = intersection(area, rectangle{{0, 0}, target.size()});
+	if (visible.empty() || source.width() == 0 || source.height() == 0)
+		return;
+
+	if (area.size == source.size())
+		draw(target, source, area.top_left, visible);
+	else if (filter == scale_filter::nearest)
+		scale_nearest(target, source, area, visible);
+	else
+		scale_bilinear(target, source, area, visible);
+
+	target.damage(visible);
+}
+
+}  // namespace sgfx
@@ -0,0 +1,55 @@
+#include <sgfx/headless.hpp>
+#include <sgfx/screen.hpp>
+#include <sgfx/trace.hpp>
+
+#if defined(SGFX_WITH_WINDOW)
+#	include <sgfx/window.hpp>
+#endif
+
+#include <cstdlib>
+#include <string>
+
+namespace sgfx {
+
+std::unique_ptr<screen> make_screen(std::uint16_t w, std::uint16_t h, const char* title)
+{
+	auto const env = [](char const* name) -> std::string {
+		char const* value = std::getenv(name);
+		return value ? value : "";
+	};
+
+	if (auto const trace = env("SGFX_TRACE"); !trace.empty() && !tracing())
+		start_tracing(trace);
+
+#if defined(SGFX_WITH_WINDOW)
+	if (env("SGFX_BACKEND") != "headless")
+	{
+		auto result = std::make_unique<window>(w, h, title);
+
+		if (auto const interval = env("SGFX_SWAP_INTERVAL"); !interval.empty())
+			result->set_swap_interval(std::stoi(interval));
+
+		if (auto const fps = env("SGFX_TARGET_FPS"); !fps.empty())
+			result->set_target_frame_rate(std::stod(fps));
+
+		result->set_statistics_dump_on_close(!env("SGFX_FRAME_STATS").empty());
+
+		return result;
+	}
+#endif
+
+	auto result = std::make_unique<headless>(w, h);
+
+	if (auto const frames = env("SGFX_FRAMES"); !frames.empty())
+		result->set_max_frames(static_cast<unsigned>(std::stoul(frames)));
+
+	if (auto const script = env("SGFX_INPUT"); !script.empty())
+		result->load_script(script);
+
+	if (auto const pattern = env("SGFX_DUMP"); !pattern.empty())
+		result->set_frame_dump(pattern);
+
+	return result;
+}
+
+}  // namespace sgfx
@@ -0,0 +1,173 @@
+#include <sgfx/thread_pool.hpp>
+
+#include <algorithm>
+
+using namespace std;
+
+namespace sgfx {
+
+namespace {
+
+/// The pool the current thread runs tasks for, i.e. one of its workers or a thread inside parallel_for().
+thread_local thread_pool const* current_pool = nullptr;
+
+/// Marks the current thread as running tasks for a pool until destruction.
+class pool_scope {
+  public:
+	explicit pool_scope(thread_pool const* pool) : previous_{current_pool} { current_pool = pool; }
+	~pool_scope() { current_pool = previous_; }
+
+	pool_scope(pool_scope const&) = delete;
+	pool_scope& operator=(pool_scope const&) = delete;
+
+  private:
+	thread_pool const* previous_;
+};
+
+}  // namespace
+
+thread_pool::thread_pool(unsigned concurrency)
+{
+	concurrency = max(concurrency, 1u);
+
+	for (unsigned i = 0; i < concurrency; ++i)
+		queues_.emplace_back(make_unique<queue>());
+
+	for (unsigned i = 0; i + 1 < concurrency; ++i)
+		threads_.emplace_back(&thread_pool::worker, this, i);
+}
+
+thread_pool::~thread_pool()
+{
+	{
+		lock_guard<mutex> _l{mutex_};
+		quit_ = true;
+	}
+	wakeup_.notify_all();
+
+	for (thread& t : threads_)
+		t.join();
+}
+
+thread_pool& thread_pool::shared()
+{
+	static thread_pool pool;
+	return pool;
+}
+
+void thread_pool::parallel_for(size_t count, task const& fn)
+{
+	if (count == 0)
+		return;
+
+	// nested in one of our own tasks, which would wait for itself below
+	if (current_pool == this)
+	{
+		for (size_t i = 0; i < count; ++i)
+			fn(i);
+		return;
+	}
+
+	lock_guard<mutex> _s{submit_};
+	pool_scope const scope{this};
+
+	{
+		lock_guard<mutex> _l{mutex_};
+		task_ = &fn;
+		error_ = nullptr;
+		pending_ = count;
+
+		// hand out contiguous blocks, so neighbouring indices tend to stay on the same thread
+		auto const block = (count + queues_.size() - 1) / queues_.size();
+		for (size_t i = 0; i < count; ++i)
+		{
+			auto& q = *queues_[i / block];
+			lock_guard<mutex> _q{q.lock};
+			q.items.push_back(i);
+		}
+
+		++generation_;
+	}
+	wakeup_.notify_all();
+
+	while (run_one(queues_.size() - 1))
+		;
+
+	unique_lock<mutex> lock{mutex_};
+	done_.wait(lock, [&]() { return pending_ == 0; });
+	task_ = nullptr;
+
+	if (error_)
+		rethrow_exception(error_);
+}
+
+void thread_pool::worker(size_t id)
+{
+	pool_scope const scope{this};
+	size_t seen = 0;
+	for (;;)
+	{
+		{
+			unique_lock<mutex> lock{mutex_};
+			wakeup_.wait(lock, [&]() { return quit_ || generation_ != seen; });
+			if (quit_)
+				return;
+			seen = generation_;
+		}
+
+		while (run_one(id))
+			;
+	}
+}
+
+bool thread_pool::run_one(size_t id)
+{
+	auto const pop = [](queue& q, bool own, size_t& index) -> bool {
+		lock_guard<mutex> _q{q.lock};
+		if (q.items.empty())
+			return false;
+
+		if (own)
+		{
+			index = q.items.front();
+			q.items.pop_front();
+		}
+		else
+		{
+			index = q.items.back();
+			q.items.pop_back();
+		}
+		return true;
+	};
+
+	size_t index = 0;
+	bool found = pop(*queues_[id], true, index);
+
+	// steal from the other queues
+	for (size_t i = 1; !found && i < queues_.size(); ++i)
+		found = pop(*queues_[(id + i) % queues_.size()], false, index);
+
+	if (!found)
+		return false;
+
+	try
+	{
+		(*task_)(index);
+	}
+	catch (...)
+	{
+		lock_guard<mutex> _l{mutex_};
+		if (!error_)
+			error_ = current_exception();
+	}
+
+	if (--pending_ == 0)
+	{
+		lock_guard<mutex> _l{mutex_};
+		done_.notify_all();
+	}
+
+	return true;
+}
+
+}  // namespace sgfx
@@ -0,0 +1,152 @@
+#include <sgfx/trace.hpp>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+namespace sgfx {
+
+namespace {
+
+using clock = chrono::steady_clock;
+
+/// Spans retained per thread.
+constexpr size_t ring_size = 1 << 16;
+
+struct span {
+	char const* name;
+	char const* category;
+	clock::time_point begin;
+	clock::time_point end;
+};
+
+/// Spans of a single thread, written by that thread only, except while being flushed.
+struct ring {
+	mutex lock;
+	vector<span> spans;
+	size_t next = 0;  // index to write the next span to, once spans is full
+	unsigned thread_id;
+};
+
+struct registry {
+	mutex lock;
+	string path;
+	clock::time_point origin;
+	vector<shared_ptr<ring>> rings;  // shared with the threads, so that spans outlive the threads
+	bool exit_handler = false;
+};
+
+atomic<bool> enabled{false};
+
+registry& global()
+{
+	static registry instance;
+	return instance;
+}
+
+ring& local()
+{
+	thread_local shared_ptr<ring> const instance = [] {
+		auto r = make_shared<ring>();
+		auto& reg = global();
+		lock_guard<mutex> _l{reg.lock};
+		r->thread_id = static_cast<unsigned>(reg.rings.size() + 1);
+		reg.rings.push_back(r);
+		return r;
+	}();
+	return *instance;
+}
+
+}  // namespace
+
+void start_tracing(string path)
+{
+	auto& reg = global();
+	{
+		lock_guard<mutex> _l{reg.lock};
+		reg.path = move(path);
+		reg.origin = clock::now();
+		for (auto& r : reg.rings)
+		{
+			lock_guard<mutex> _r{r->lock};
+			r->spans.clear();
+			r->next = 0;
+		}
+
+		if (!reg.exit_handler)
+		{
+			reg.exit_handler = true;
+			atexit(stop_tracing);
+		}
+	}
+	enabled = true;
+}
+
+void stop_tracing()
+{
+	if (!enabled.exchange(false))
+		return;
+
+	auto& reg = global();
+	lock_guard<mutex> _l{reg.lock};
+
+	FILE* const out = fopen(reg.path.c_str(), "w");
+	if (!out)
+	{
+		fprintf(stderr, "Could not open trace file %s.\n", reg.path.c_str());
+		return;
+	}
+
+	auto const micros = [&](clock::time_point t) {
+		return chrono::duration<double, micro>{t - reg.origin}.count();
+	};
+
+	fputs("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [", out);
+	auto separator = "\n";
+	for (auto const& r : reg.rings)
+	{
+		lock_guard<mutex> _r{r->lock};
+
+		// oldest first, which is where the next span would go once the ring wrapped around
+		for (size_t i = 0; i < r->spans.size(); ++i)
+		{
+			auto const& s = r->spans[(r->next + i) % r->spans.size()];
+			fprintf(out, "%s{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, "
+						 "\"pid\": 1, \"tid\": %u}",
+					separator, s.name, s.category, micros(s.begin), micros(s.end) - micros(s.begin),
+					r->thread_id);
+			separator = ",\n";
+		}
+	}
+	fputs("\n]}\n", out);
+	fclose(out);
+}
+
+bool tracing() noexcept
+{
+	return enabled.load(memory_order_relaxed);
+}
+
+void record_span(char const* name, char const* category, clock::time_point begin,
+				 clock::time_point end) noexcept
+{
+	if (!tracing())
+		return;
+
+	auto& r = local();
+	lock_guard<mutex> _l{r.lock};
+	if (r.spans.size() < ring_size)
+		r.spans.push_back(span{name, category, begin, end});
+	else
+	{
+		r.spans[r.next] = span{name, category, begin, end};
+		r.next = (r.next + 1) % ring_size;
+	}
+}
+
+}  // namespace sgfx
@@ -1,6 +1,11 @@
+#include <sgfx/trace.hpp>
 #include <sgfx/window.hpp>
 
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
 #include <stdexcept>
+#include <thread>
 
 namespace {
 
@@ -128,6 +133,7 @@ window::window(std::uint16_t w, std::uint16_t h, const char* title)
 
 	glGenTextures(1, &texture_id_);
 	glBindTexture(GL_TEXTURE_2D, texture_id_);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width_, height_, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels_.data());
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -137,6 +143,11 @@ window::window(std::uint16_t w, std::uint16_t h, const char* title)
 
 window::~window()
 {
+	if (dump_statistics_)
+		stats_.dump(std::cerr);
+
+	glfwMakeContextCurrent(wnd_);
+	set_pixel_buffer_count(0);
 	glfwDestroyWindow(wnd_);
 	glDeleteVertexArrays(1, &vao_id_);
 	glDeleteBuffers(1, &vbo_id_);
@@ -159,17 +170,264 @@ bool window::is_pressed(key_id key) const
 	return glfwGetKey(wnd_, key.id_) == GLFW_PRESS;
 }
 
-void window::show() const
+void window::damage(rectangle const& area)
+{
+	if (!damage_tracking_)
+		return;
+
+	auto const clipped = intersection(area, rectangle{{0, 0}, size()});
+	if (clipped.empty())
+		return;
+
+	std::lock_guard<std::mutex> _l{damage_lock_};
+	for (int y = clipped.top(); y < clipped.bottom(); ++y)
+	{
+		damage_left_[y] = std::min(damage_left_[y], clipped.left());
+		damage_right_[y] = std::max(damage_right_[y], clipped.right());
+	}
+}
+
+void window::set_damage_tracking(bool enabled)
+{
+	damage_tracking_ = enabled;
+
+	if (enabled)
+	{
+		// we don't know what changed before tracking started, so the next show() uploads everything
+		damage_left_.assign(height_, 0);
+		damage_right_.assign(height_, width_);
+	}
+	else
+	{
+		damage_left_.clear();
+		damage_right_.clear();
+	}
+}
+
+void window::reset_damage()
+{
+	damage_left_.assign(height_, width_);
+	damage_right_.assign(height_, 0);
+}
+
+void window::collect_damaged_bands()
+{
+	std::size_t damaged = 0;
+	for (int y = 0; y < height_; ++y)
+		if (damage_left_[y] < damage_right_[y])
+			damaged += damage_right_[y] - damage_left_[y];
+
+	if (damaged > full_upload_threshold_ * width_ * height_)
+	{
+		bands_.push_back(rectangle{{0, 0}, size()});
+		return;
+	}
+
+	// bands of consecutive damaged rows, each spanning the union of its rows' damaged columns
+	for (int y = 0; y < height_;)
+	{
+		if (damage_left_[y] >= damage_right_[y])
+		{
+			++y;
+			continue;
+		}
+
+		int const top = y;
+		int left = damage_left_[y];
+		int right = damage_right_[y];
+		for (++y; y < height_ && damage_left_[y] < damage_right_[y]; ++y)
+		{
+			left = std::min(left, damage_left_[y]);
+			right = std::max(right, damage_right_[y]);
+		}
+
+		bands_.push_back(rectangle{{left, top}, {right - left, y - top}});
+	}
+}
+
+bool window::set_pixel_buffer_count(unsigned count)
+{
+	if (count != 0 && !GLEW_VERSION_2_1 && !GLEW_ARB_pixel_buffer_object)
+		return false;
+
+	glfwMakeContextCurrent(wnd_);
+
+	if (mapped_)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_ids_[next_pbo_]);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		mapped_ = nullptr;
+	}
+
+	if (!pbo_ids_.empty())
+		glDeleteBuffers(static_cast<GLsizei>(pbo_ids_.size()), pbo_ids_.data());
+
+	pbo_ids_.resize(count);
+	next_pbo_ = 0;
+
+	if (count != 0)
+	{
+		auto const bytes = static_cast<GLsizeiptr>(pixels_.size() * sizeof(color::rgb_color));
+		glGenBuffers(static_cast<GLsizei>(count), pbo_ids_.data());
+		for (GLuint id : pbo_ids_)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, id);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	return true;
+}
+
+color::rgb_color* window::map_next_pixel_buffer()
+{
+	auto const bytes = static_cast<GLsizeiptr>(pixels_.size() * sizeof(color::rgb_color));
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_ids_[next_pbo_]);
+
+	// orphan the previous storage, so we never wait for a transfer still reading from it
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+	return static_cast<color::rgb_color*>(glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY));
+}
+
+color::rgb_color* window::map_pixel_buffer()
+{
+	if (pbo_ids_.empty())
+		return nullptr;
+
+	if (!mapped_)
+	{
+		glfwMakeContextCurrent(wnd_);
+		mapped_ = map_next_pixel_buffer();
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	return mapped_;
+}
+
+void window::upload_bands()
+{
+	// base is either a client memory address or an offset into the bound pixel buffer object
+	auto const upload = [this](std::uintptr_t base) {
+		uploaded_bytes_ = 0;
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, width_);
+		for (rectangle const& band : bands_)
+		{
+			auto const offset = (band.top() * width_ + band.left()) * sizeof(color::rgb_color);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, band.left(), band.top(), band.size.width, band.size.height, GL_RGB,
+							GL_UNSIGNED_BYTE, reinterpret_cast<void const*>(base + offset));
+			uploaded_bytes_ += band.size.width * band.size.height * sizeof(color::rgb_color);
+		}
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	};
+
+	if (pbo_ids_.empty())
+		return upload(reinterpret_cast<std::uintptr_t>(pixels_.data()));
+
+	// Fill the current pixel buffer object (unless the caller already rendered into it) and let the
+	// driver transfer it asynchronously, while the next frame goes into the next buffer object.
+	if (mapped_)
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo_ids_[next_pbo_]);
+	else if (auto target = map_next_pixel_buffer(); target != nullptr)
+	{
+		for (rectangle const& band : bands_)
+			for (int y = band.top(); y < band.bottom(); ++y)
+			{
+				auto const offset = y * width_ + band.left();
+				std::copy_n(&pixels_[offset], band.size.width, target + offset);
+			}
+	}
+	else
+	{
+		// mapping failed, fall back to the synchronous path for this frame
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return upload(reinterpret_cast<std::uintptr_t>(pixels_.data()));
+	}
+
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	mapped_ = nullptr;
+
+	upload(0);
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	next_pbo_ = (next_pbo_ + 1) % pbo_ids_.size();
+}
+
+void window::set_swap_interval(int interval)
 {
 	glfwMakeContextCurrent(wnd_);
+	glfwSwapInterval(interval);
+}
+
+void window::set_target_frame_rate(double fps) noexcept
+{
+	target_frame_rate_ = fps > 0 ? fps : 0;
+	auto const interval = std::chrono::duration<double>{fps > 0 ? 1 / fps : 0};
+	frame_interval_ = std::chrono::duration_cast<clock::duration>(interval);
+	next_frame_ = clock::time_point{};
+}
+
+void window::show()
+{
+	frame_timing timing;
+	auto const start = clock::now();
+	if (frame_end_ != clock::time_point{})
+		timing.render = start - frame_end_;
+
+	glfwMakeContextCurrent(wnd_);
 
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D, texture_id_);
-	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width_, height_, GL_RGB, GL_UNSIGNED_BYTE, pixels_.data());
+
+	bands_.clear();
+	if (damage_tracking_)
+	{
+		std::lock_guard<std::mutex> _l{damage_lock_};
+		if (!mapped_)
+			collect_damaged_bands();
+		reset_damage();
+	}
+
+	if (mapped_ || !damage_tracking_)
+		bands_.push_back(rectangle{{0, 0}, size()});
+
+	upload_bands();
+
+	auto const uploaded = clock::now();
+	timing.upload = uploaded - start;
 
 	glBindVertexArray(vao_id_);
 
 	glDrawArrays(GL_TRIANGLES, 0, 6);
 
 	glfwSwapBuffers(wnd_);
+
+	auto const swapped = clock::now();
+	timing.swap = swapped - uploaded;
+
+	if (frame_interval_ != clock::duration::zero())
+	{
+		next_frame_ += frame_interval_;
+		if (next_frame_ < swapped)
+			next_frame_ = swapped;
+		else
+			std::this_thread::sleep_until(next_frame_);
+	}
+
+	auto const previous_end = frame_end_;
+	frame_end_ = clock::now();
+	timing.wait = frame_end_ - swapped;
+	stats_.record(timing);
+
+	if (tracing())
+	{
+		if (previous_end != clock::time_point{})
+			record_span("render", "frame", previous_end, start);
+		record_span("show", "frame", start, frame_end_);
+		record_span("upload", "frame", start, uploaded);
+		record_span("swap", "frame", uploaded, swapped);
+		record_span("wait", "frame", swapped, frame_end_);
+	}
 }
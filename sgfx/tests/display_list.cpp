@@ -0,0 +1,135 @@
+#include <sgfx/canvas.hpp>
+#include <sgfx/color.hpp>
+#include <sgfx/display_list.hpp>
+#include <sgfx/image.hpp>
+#include <sgfx/primitives.hpp>
+#include <sgfx/thread_pool.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace std;
+using namespace sgfx;
+
+namespace {
+
+int failures = 0;
+
+void expect(bool condition, string const& what)
+{
+	if (!condition) {
+		cerr << "FAILED: " << what << '\n';
+		++failures;
+	}
+}
+
+/// A small image with a distinct color per pixel, so misplaced blits show up.
+canvas pattern(dimension size)
+{
+	auto image = canvas{size};
+	for (int y = 0; y < size.height; ++y)
+		for (int x = 0; x < size.width; ++x)
+			image.pixels()[y * size.width + x] = color::rgb_color(static_cast<uint8_t>(x * 16),
+																   static_cast<uint8_t>(y * 16), 200);
+	return image;
+}
+
+/// Issues the same draw calls on @p target, which is either a canvas or a display_list.
+template <typename Target>
+void scene(Target&& target, canvas const& image, rle_image const& sprite)
+{
+	auto const orange = color::rgb_color{255, 128, 0};
+	auto const teal = color::rgb_color{0, 128, 128};
+
+	target.clear(color::blue);
+
+	// overlapping fills across tile borders, partly off-screen
+	target.fill({{10, 10}, {100, 60}}, color::red);
+	target.fill({{50, 30}, {100, 60}}, color::green);
+	target.fill({{-20, -20}, {40, 40}}, orange);
+	target.fill({{180, 120}, {100, 100}}, teal);
+	target.hline({0, 64}, 200, color::white);
+	target.vline({63, 0}, 150, color::black);
+
+	// lines crossing tiles in all directions, off-screen and far off-screen
+	target.line({0, 0}, {199, 149}, color::white);
+	target.line({199, 0}, {0, 149}, color::yellow);
+	target.line({-50, 70}, {250, 80}, color::black);
+	target.line({100, -500}, {110, 600}, orange);
+	target.line({-1'100'000'000, 5}, {1'100'000'000, 40}, color::white);
+	target.line({150, -1'100'000'000}, {130, 1'100'000'000}, color::red);
+
+	// blits overlapping the lines and fills, clipped at every edge
+	target.draw(image, {56, 56});
+	target.draw(image, {-5, 100});
+	target.draw(image, {190, -8});
+	target.draw(sprite, {120, 60});
+	target.draw(sprite, {195, 145}, color::black);
+	target.draw(sprite, {-10, -10}, color::black);
+
+	target.plot({64, 64}, teal);
+	target.plot({500, 500}, teal);  // clamped to the bottom right pixel
+}
+
+/// Forwards the calls of scene() to the immediate mode functions.
+struct immediate {
+	widget& target;
+
+	void clear(color::rgb_color col) { sgfx::clear(target, col); }
+	void fill(rectangle rect, color::rgb_color col) { sgfx::fill(target, rect, col); }
+	void hline(point p, uint16_t length, color::rgb_color col) { sgfx::hline(target, p, length, col); }
+	void vline(point p, uint16_t length, color::rgb_color col) { sgfx::vline(target, p, length, col); }
+	void line(point p0, point p1, color::rgb_color col) { sgfx::line(target, p0, p1, col); }
+	void plot(point p, color::rgb_color col) { sgfx::plot(target, p, col); }
+	void draw(canvas const& img, point top_left) { sgfx::draw(target, img, top_left); }
+	void draw(rle_image const& img, point top_left) { sgfx::draw(target, img, top_left); }
+	void draw(rle_image const& img, point top_left, color::rgb_color colorkey)
+	{
+		sgfx::draw(target, img, top_left, colorkey);
+	}
+};
+
+/// Renders scene() through a display_list of @p tile_size and compares it to immediate mode.
+void matches_immediate_mode(int tile_size)
+{
+	auto image = pattern({16, 16});
+
+	// a sprite with transparent (black) holes
+	auto sprite_image = pattern({24, 12});
+	sgfx::fill(sprite_image, {{4, 2}, {8, 6}}, color::black);
+	auto const sprite = rle_encode(sprite_image);
+
+	auto expected = canvas{{200, 150}};
+	scene(immediate{expected}, image, sprite);
+
+	auto pool = thread_pool{4};
+	auto list = display_list{tile_size};
+	scene(list, image, sprite);
+
+	// twice, as bins are reused across frames
+	for (int frame = 0; frame < 2; ++frame) {
+		auto actual = canvas{{200, 150}};
+		list.submit(actual, pool);
+
+		auto const name = "tile size " + to_string(tile_size) + ", frame " + to_string(frame) + ": ";
+		auto mismatches = 0;
+		for (int y = 0; y < 150; ++y)
+			for (int x = 0; x < 200; ++x)
+				if (actual.pixels()[y * 200 + x] != expected.pixels()[y * 200 + x] && mismatches++ < 5)
+					expect(false, name + "pixel {" + to_string(x) + ", " + to_string(y) + "} differs");
+		expect(mismatches == 0, name + to_string(mismatches) + " pixels differ from immediate mode");
+	}
+}
+
+}  // namespace
+
+int main()
+{
+	for (int tile_size : {64, 16, 7})
+		matches_immediate_mode(tile_size);
+
+	if (failures)
+		cerr << failures << " checks failed.\n";
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,87 @@
+#include <sgfx/canvas.hpp>
+#include <sgfx/color.hpp>
+#include <sgfx/primitives.hpp>
+
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace sgfx;
+
+namespace {
+
+int failures = 0;
+
+void expect(bool condition, string const& what)
+{
+	if (!condition) {
+		cerr << "FAILED: " << what << '\n';
+		++failures;
+	}
+}
+
+/// Rows of the pixels set in each column of @p image, from top to bottom.
+vector<vector<int>> columns(canvas& image)
+{
+	auto result = vector<vector<int>>(image.width());
+	for (int y = 0; y < image.height(); ++y)
+		for (int x = 0; x < image.width(); ++x)
+			if (image.pixels()[y * image.width() + x] == color::white)
+				result[x].push_back(y);
+	return result;
+}
+
+/// A line from far off-screen left to far off-screen right, whose 33-bit extent used to overflow.
+void far_endpoints()
+{
+	auto image = canvas{{16, 16}};
+	line(image, {-1'100'000'000, 5}, {1'100'000'000, 10}, color::white);
+
+	// k(i) = floor((2 * 5 * i + 2.2e9 - 1) / 4.4e9) with i = x + 1.1e9 is 2 at x = 0 and 3 after
+	auto const set = columns(image);
+	expect(set[0] == vector<int>{7}, "far endpoints: column 0 is at row 7");
+	for (int x = 1; x < 16; ++x)
+		expect(set[x] == vector<int>{8}, "far endpoints: column " + to_string(x) + " is at row 8");
+}
+
+/// Lines between endpoints near INT_MIN and INT_MAX, in either direction.
+void extreme_endpoints()
+{
+	for (auto const& [p0, p1] : {pair{point{INT_MIN + 1, 3}, point{INT_MAX, 12}},
+								 pair{point{INT_MAX, 12}, point{INT_MIN + 1, 3}},
+								 pair{point{INT_MIN, 12}, point{INT_MAX, 3}}}) {
+		auto image = canvas{{16, 16}};
+		line(image, p0, p1, color::white);
+
+		auto const name = "extreme endpoints {" + to_string(p0.x) + ", " + to_string(p0.y) + "} -> {"
+						  + to_string(p1.x) + ", " + to_string(p1.y) + "}: ";
+		auto const set = columns(image);
+		for (int x = 0; x < 16; ++x) {
+			expect(set[x].size() == 1, name + "one pixel in column " + to_string(x));
+			expect(set[x].empty() || (set[x][0] == 7 || set[x][0] == 8), name + "near the middle row");
+		}
+	}
+
+	// steep, walking along y
+	auto image = canvas{{16, 16}};
+	line(image, {5, INT_MIN}, {10, INT_MAX}, color::white);
+	auto rows = 0;
+	for (auto const& pixel : image.pixels())
+		rows += pixel == color::white;
+	expect(rows == 16, "steep extreme endpoints: one pixel per row");
+}
+
+}  // namespace
+
+int main()
+{
+	far_endpoints();
+	extreme_endpoints();
+
+	if (failures)
+		cerr << failures << " checks failed.\n";
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,86 @@
+#include <sgfx/thread_pool.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+using namespace sgfx;
+
+namespace {
+
+int failures = 0;
+
+void expect(bool condition, string const& what)
+{
+	if (!condition) {
+		cerr << "FAILED: " << what << '\n';
+		++failures;
+	}
+}
+
+/// parallel_for() on the same pool from within its tasks, which used to deadlock.
+void nested()
+{
+	auto pool = thread_pool{4};
+	auto sum = atomic<size_t>{0};
+
+	pool.parallel_for(16, [&](size_t i) {
+		pool.parallel_for(10, [&](size_t j) {
+			pool.parallel_for(2, [&](size_t) { sum += i * 10 + j; });
+		});
+	});
+
+	// twice the sum of 0 ... 159
+	expect(sum == 2 * 159 * 160 / 2, "nested: every inner index visited twice");
+}
+
+/// Exceptions thrown by nested loops reach the outermost caller.
+void nested_throw()
+{
+	auto pool = thread_pool{4};
+	auto caught = false;
+	try {
+		pool.parallel_for(8, [&](size_t i) {
+			pool.parallel_for(4, [&](size_t j) {
+				if (i == 5 && j == 2)
+					throw runtime_error{"nested"};
+			});
+		});
+	}
+	catch (runtime_error const& e) {
+		caught = string{e.what()} == "nested";
+	}
+	expect(caught, "nested throw: rethrown on the calling thread");
+
+	// the pool is still usable afterwards
+	auto count = atomic<size_t>{0};
+	pool.parallel_for(100, [&](size_t) { ++count; });
+	expect(count == 100, "nested throw: pool usable afterwards");
+}
+
+/// A loop on one pool from within a task of another, as convert's batch mode does with the shared pool.
+void other_pool()
+{
+	auto outer = thread_pool{3};
+	auto inner = thread_pool{2};
+	auto count = atomic<size_t>{0};
+
+	outer.parallel_for(6, [&](size_t) { inner.parallel_for(5, [&](size_t) { ++count; }); });
+	expect(count == 30, "other pool: every index visited");
+}
+
+}  // namespace
+
+int main()
+{
+	nested();
+	nested_throw();
+	other_pool();
+
+	if (failures)
+		cerr << failures << " checks failed.\n";
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}